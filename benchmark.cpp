@@ -0,0 +1,1247 @@
+/*
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* Micro benchmarks of the scheduling modes of CxxThreadPool
+ * Run all with ./CxxThreadPoolBenchmark or a single one by name, e.g. ./CxxThreadPoolBenchmark batch */
+
+#include "include/CxxThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/* Every C++ heap allocation of the process is counted, for the allocations benchmark */
+static std::atomic<long long> allocations { 0 };
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+class SpinThread : public CxxThread {
+public:
+    SpinThread(int iterations)
+        : m_iterations(iterations)
+    {
+    }
+
+    inline int execute()
+    {
+        for (int i = 0; i < m_iterations; ++i)
+            m_value += i * 0.5;
+        return 0;
+    }
+
+private:
+    int m_iterations;
+    volatile double m_value = 0;
+};
+
+static double Seconds(const std::chrono::steady_clock::time_point& begin)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() / 1e6;
+}
+
+/* Benchmarks that also check a result report failures here, the process then exits with 1 */
+static int failures = 0;
+
+static void Check(bool condition, const std::string& what)
+{
+    if (condition)
+        return;
+    cout << "FAILED: " << what << endl;
+    failures++;
+}
+
+/* Hardware cache misses of this process and all threads started after Start(), -1 if perf events are not available */
+class CacheMisses {
+public:
+    CacheMisses()
+    {
+#if defined(__linux__)
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_file = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~CacheMisses()
+    {
+#if defined(__linux__)
+        if (m_file >= 0)
+            close(m_file);
+#endif
+    }
+
+    void Start()
+    {
+#if defined(__linux__)
+        if (m_file >= 0) {
+            ioctl(m_file, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_file, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long Stop()
+    {
+        long long count = -1;
+#if defined(__linux__)
+        if (m_file >= 0) {
+            ioctl(m_file, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_file, &count, sizeof(count)) != sizeof(count))
+                count = -1;
+        }
+#endif
+        return count;
+    }
+
+private:
+    int m_file = -1;
+};
+
+class TileThread : public CxxThread {
+public:
+    TileThread(const std::vector<double>* tile)
+        : m_tile(tile)
+    {
+    }
+
+    inline int execute()
+    {
+        double sum = 0;
+        for (double value : *m_tile)
+            sum += value;
+        m_sum = sum;
+        return 0;
+    }
+
+private:
+    const std::vector<double>* m_tile;
+    volatile double m_sum = 0;
+};
+
+/* Jobs reading one of many shared input tiles, submitted interleaved, with and without locality keys */
+void Locality()
+{
+    const int tiles = 64, jobs = 4096, workers = std::max<int>(std::thread::hardware_concurrency(), 2);
+    std::vector<std::vector<double>> data(tiles, std::vector<double>(64 * 1024, 1.0));
+    cout << "locality: " << jobs << " jobs reading one of " << tiles << " tiles of 512 kB, " << workers << " workers" << endl;
+    cout << "keys         time [ms]    cache misses" << endl;
+    for (int keys = 0; keys < 2; ++keys) {
+        CxxThreadPool pool;
+        pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+        pool.setActiveThreadCount(workers);
+        pool.setPersistentWorkers(true);
+        for (int i = 0; i < jobs; ++i) {
+            TileThread* thread = new TileThread(&data[i % tiles]);
+            if (keys)
+                thread->setLocalityKey(i % tiles);
+            pool.addThread(thread);
+        }
+        CacheMisses misses;
+        misses.Start();
+        auto begin = std::chrono::steady_clock::now();
+        pool.StartAndWait();
+        double seconds = Seconds(begin);
+        long long count = misses.Stop();
+        cout << (keys ? "yes" : "no ") << setw(18) << int(seconds * 1e3) << setw(16);
+        if (count >= 0)
+            cout << count << endl;
+        else
+            cout << "n/a" << endl;
+    }
+}
+
+class SleepThread : public CxxThread {
+public:
+    SleepThread(int microseconds)
+        : m_microseconds(microseconds)
+    {
+    }
+
+    inline int execute()
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(m_microseconds));
+        return 0;
+    }
+
+private:
+    int m_microseconds;
+};
+
+static double Percentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min<std::size_t>(std::ceil(percentile * values.size()), values.size()) - 1];
+}
+
+/* Latency of urgent jobs submitted while the pool is saturated with long jobs */
+void Urgent()
+{
+    const int workers = 4, jobs = 100;
+    cout << "urgent: " << jobs << " jobs of 20 ms on " << workers << " slots, a short urgent job every 5 ms" << endl;
+    cout << "mode                 reserved   urgent jobs   p50 [ms]   p99 [ms]" << endl;
+    for (int persistent = 0; persistent < 2; ++persistent) {
+        for (int reserved = 0; reserved < 2; ++reserved) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(persistent);
+            pool.setReservedWorkers(reserved, 50);
+            pool.setWakeUp(10);
+            for (int i = 0; i < jobs; ++i)
+                pool.addThread(new SleepThread(20000));
+            std::atomic<bool> running(true);
+            std::thread submitter([&pool, &running]() {
+                while (running) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    if (running)
+                        pool.addUrgentThread(new SleepThread(200));
+                }
+            });
+            pool.StartAndWait();
+            running = false;
+            submitter.join();
+            std::vector<double> latencies;
+            for (const auto* thread : pool.Finished())
+                if (thread->Urgent())
+                    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(thread->StartTime() - thread->SubmitTime()).count() / 1e3);
+            cout << (persistent ? "persistent workers " : "thread per job     ") << setw(10) << reserved << setw(14) << latencies.size()
+                 << setw(11) << fixed << setprecision(2) << Percentile(latencies, 0.5) << setw(11) << Percentile(latencies, 0.99) << endl;
+            cout.unsetf(std::ios_base::floatfield);
+        }
+    }
+}
+
+/* Deadline misses of FIFO and EDF order for jobs submitted latest deadline first, with and without overload */
+void Deadline()
+{
+    const int workers = 4, jobs = 200, runtime = 5;
+    cout << "deadline: " << jobs << " jobs of " << runtime << " ms on " << workers << " slots, submitted latest deadline first" << endl;
+    cout << "mode                 load   missed   shed   p50 late [ms]   p99 late [ms]" << endl;
+    for (double load : { 0.8, 1.25 }) {
+        for (int mode = 0; mode < 3; ++mode) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setDeadlineShedding(mode == 2);
+            pool.setWakeUp(1);
+            /* the deadlines leave 1 / load of the time needed to run all jobs */
+            auto base = std::chrono::system_clock::now() + std::chrono::milliseconds(20);
+            std::vector<std::pair<CxxThread*, std::chrono::system_clock::time_point>> deadlines;
+            for (int i = jobs; i > 0; --i) {
+                auto deadline = base + std::chrono::microseconds(static_cast<long long>(i * runtime * 1000.0 / workers / load));
+                CxxThread* thread = new SleepThread(runtime * 1000);
+                thread->setPredictedCost(runtime);
+                if (mode)
+                    thread->setDeadline(deadline);
+                deadlines.push_back(std::make_pair(thread, deadline));
+                pool.addThread(thread);
+            }
+            pool.StartAndWait();
+            std::vector<double> lateness;
+            int missed = 0, shed = 0;
+            for (const auto& entry : deadlines) {
+                if (entry.first->Shed()) {
+                    shed++;
+                    continue;
+                }
+                lateness.push_back(std::chrono::duration_cast<std::chrono::microseconds>(entry.first->EndTime() - entry.second).count() / 1e3);
+                missed += lateness.back() > 0;
+            }
+            const char* names[] = { "FIFO               ", "EDF                ", "EDF with shedding  " };
+            cout << names[mode] << setw(6) << fixed << setprecision(2) << load << setw(9) << missed + shed << setw(7) << shed
+                 << setw(16) << Percentile(lateness, 0.5) << setw(16) << Percentile(lateness, 0.99) << endl;
+            cout.unsetf(std::ios_base::floatfield);
+        }
+    }
+}
+
+/* Completion of two small tenants submitting after a large batch of another tenant, first come first served and fair share */
+void Tenant()
+{
+    const int workers = 4;
+    const int counts[] = { 1000, 50, 50 }, runtimes[] = { 2, 4, 1 };
+    const double weights[] = { 1, 1, 2 };
+    cout << "tenant: tenant 0 submits " << counts[0] << " jobs of " << runtimes[0] << " ms before tenant 1 ( " << counts[1] << " x " << runtimes[1]
+         << " ms ) and tenant 2 ( " << counts[2] << " x " << runtimes[2] << " ms, weight 2 ) on " << workers << " workers" << endl;
+    cout << "mode                          tenant   jobs   done after [ms]      jobs/s" << endl;
+    for (int persistent = 0; persistent < 2; ++persistent) {
+        for (int fair = 0; fair < 2; ++fair) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(persistent);
+            pool.setWakeUp(1);
+            std::vector<std::pair<CxxThread*, int>> jobs;
+            for (int tenant = 0; tenant < 3; ++tenant) {
+                if (fair)
+                    pool.setTenantWeight(tenant, weights[tenant]);
+                for (int i = 0; i < counts[tenant]; ++i) {
+                    CxxThread* thread = new SleepThread(runtimes[tenant] * 1000);
+                    if (fair)
+                        thread->setTenant(tenant);
+                    jobs.push_back(std::make_pair(thread, tenant));
+                    pool.addThread(thread);
+                }
+            }
+            auto begin = std::chrono::system_clock::now();
+            pool.StartAndWait();
+            for (int tenant = 0; tenant < 3; ++tenant) {
+                double done = 0;
+                for (const auto& job : jobs)
+                    if (job.second == tenant)
+                        done = std::max(done, std::chrono::duration_cast<std::chrono::microseconds>(job.first->EndTime() - begin).count() / 1e3);
+                cout << (persistent ? "persistent workers " : "thread per job     ") << (fair ? "fair share " : "FIFO       ") << setw(6) << tenant << setw(7) << counts[tenant]
+                     << setw(18) << fixed << setprecision(1) << done << setw(12) << counts[tenant] / done * 1e3 << endl;
+                cout.unsetf(std::ios_base::floatfield);
+            }
+        }
+    }
+}
+
+/* Dispatch rate of a rate limited job class next to unlimited jobs, and of a pool wide limit */
+void Rate()
+{
+    const int workers = 4, limited = 200, disabled = 50, unlimited = 400;
+    const double rate = 200, tolerance = 0.1;
+    cout << "rate: " << limited << " jobs of 1 ms ( and " << disabled << " disabled ones ) limited to " << rate << " jobs/s, next to " << unlimited << " unlimited jobs of 2 ms on " << workers << " workers" << endl;
+    cout << "mode                 limit        rate [1/s]   error   max per 100 ms   unlimited done [ms]" << endl;
+    for (int persistent = 0; persistent < 2; ++persistent) {
+        for (int pool_wide = 0; pool_wide < 2; ++pool_wide) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(persistent);
+            pool.setWakeUp(1);
+            if (pool_wide)
+                pool.setRateLimit(rate);
+            else
+                pool.setClassRateLimit(1, rate);
+            std::vector<CxxThread*> limited_jobs, unlimited_jobs;
+            /* disabled jobs are finished without a token, the enabled ones still get the full rate */
+            for (int i = 0; i < limited + disabled; ++i) {
+                CxxThread* thread = new SleepThread(1000);
+                thread->setJobClass(1);
+                if (i % 5 == 4)
+                    thread->setEnabled(false);
+                else
+                    limited_jobs.push_back(thread);
+                pool.addThread(thread);
+            }
+            for (int i = 0; i < unlimited && !pool_wide; ++i) {
+                CxxThread* thread = new SleepThread(2000);
+                unlimited_jobs.push_back(thread);
+                pool.addThread(thread);
+            }
+            auto begin = std::chrono::system_clock::now();
+            pool.StartAndWait();
+            std::vector<double> starts;
+            for (const auto* thread : limited_jobs)
+                starts.push_back(std::chrono::duration_cast<std::chrono::microseconds>(thread->StartTime() - begin).count() / 1e3);
+            std::sort(starts.begin(), starts.end());
+            double achieved = (starts.size() - 1) / (starts.back() - starts.front()) * 1e3;
+            int window = 0;
+            for (std::size_t i = 0, j = 0; i < starts.size(); ++i) {
+                while (starts[i] - starts[j] >= 100)
+                    ++j;
+                window = std::max(window, int(i - j + 1));
+            }
+            double done = 0;
+            for (const auto* thread : unlimited_jobs)
+                done = std::max(done, std::chrono::duration_cast<std::chrono::microseconds>(thread->EndTime() - begin).count() / 1e3);
+            cout << (persistent ? "persistent workers " : "thread per job     ") << (pool_wide ? "pool      " : "class     ") << fixed << setprecision(1)
+                 << setw(12) << achieved << setw(7) << (achieved / rate - 1) * 100 << "%" << setw(17) << window << setw(22) << done << endl;
+            cout.unsetf(std::ios_base::floatfield);
+            Check(std::abs(achieved / rate - 1) <= tolerance, "rate within " + std::to_string(int(tolerance * 100)) + " % of the limit");
+        }
+    }
+}
+
+/* Active workers and throughput of eco mode for different throughput targets */
+void Eco()
+{
+    const int workers = 8, jobs = 2000, runtime = 2;
+    cout << "eco: " << jobs << " jobs of " << runtime << " ms on up to " << workers << " persistent workers" << endl;
+    cout << "target [1/s]   mean workers      jobs/s   time [s]" << endl;
+    for (double target : { 0.0, 500.0, 1000.0, 2000.0, 4000.0, -1.0 }) {
+        CxxThreadPool pool;
+        pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+        pool.setActiveThreadCount(workers);
+        pool.setPersistentWorkers(true);
+        pool.setEcoMode(target >= 0, target);
+        pool.setWakeUp(10);
+        for (int i = 0; i < jobs; ++i)
+            pool.addThread(new SleepThread(runtime * 1000));
+        auto begin = std::chrono::steady_clock::now();
+        pool.StartAndWait();
+        double seconds = Seconds(begin);
+        double worker_seconds = 0, eco_seconds = 0;
+        for (const auto& sample : pool.EcoStatistics()) {
+            worker_seconds += sample.workers * sample.seconds;
+            eco_seconds += sample.seconds;
+        }
+        cout << setw(12) << (target < 0 ? std::string("off") : std::to_string(int(target))) << fixed << setprecision(2)
+             << setw(15) << (eco_seconds > 0 ? worker_seconds / eco_seconds : double(workers))
+             << setw(12) << jobs / seconds << setw(11) << seconds << endl;
+        cout.unsetf(std::ios_base::floatfield);
+        if (target == 2000.0)
+            pool.PrintEcoStatistics();
+    }
+}
+
+#if defined(__linux__)
+/* Iterations per second of a forked foreground process spinning for seconds while the pool runs, -1 on error */
+static double Competitor(CxxThreadPool* pool, double seconds)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        volatile double value = 0;
+        long long iterations = 0;
+        auto begin = std::chrono::steady_clock::now();
+        while (Seconds(begin) < seconds) {
+            for (int i = 0; i < 10000; ++i)
+                value += i * 0.5;
+            iterations += 10000;
+        }
+        double rate = iterations / Seconds(begin);
+        ssize_t written = write(fds[1], &rate, sizeof(rate));
+        _exit(written == sizeof(rate) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pool)
+        pool->StartAndWait();
+    double rate = -1;
+    if (read(fds[0], &rate, sizeof(rate)) != sizeof(rate))
+        rate = -1;
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    return rate;
+}
+#endif
+
+/* Progress of a competing foreground process next to a CPU bound pool with different worker scheduling */
+void Nice()
+{
+#if defined(__linux__)
+    const int workers = 4, jobs = 400;
+    const double seconds = 0.5;
+    cout << "nice: a foreground process spins for " << seconds << " s next to " << jobs << " jobs of about a millisecond on " << workers << " workers" << endl;
+    double alone = Competitor(nullptr, seconds);
+    cout << "mode                    foreground speed   pool jobs/s   errors" << endl;
+    const char* names[] = { "default                 ", "nice 19                 ", "SCHED_BATCH, nice 10    ", "SCHED_IDLE, I/O idle    " };
+    for (int mode = 0; mode < 4; ++mode) {
+        CxxThreadPool pool;
+        pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+        pool.setActiveThreadCount(workers);
+        pool.setPersistentWorkers(true);
+        CxxThreadPool::Scheduling scheduling;
+        if (mode == 1)
+            scheduling.nice = 19;
+        else if (mode == 2) {
+            scheduling.policy = CxxThreadPool::Scheduling::Policy::Batch;
+            scheduling.nice = 10;
+        } else if (mode == 3) {
+            scheduling.policy = CxxThreadPool::Scheduling::Policy::Idle;
+            scheduling.io_class = CxxThreadPool::Scheduling::IoClass::Idle;
+        }
+        pool.setScheduling(scheduling);
+        for (int i = 0; i < jobs; ++i)
+            pool.addThread(new SpinThread(500000));
+        auto begin = std::chrono::steady_clock::now();
+        double rate = Competitor(&pool, seconds);
+        double pool_seconds = Seconds(begin);
+        cout << names[mode] << setw(17) << fixed << setprecision(1) << rate / alone * 100 << "%" << setw(14) << jobs / pool_seconds
+             << setw(9) << pool.SchedulingErrors() << endl;
+        cout.unsetf(std::ios_base::floatfield);
+    }
+#endif
+}
+
+/* Time and memory to start 256 persistent workers with default and small stacks, started as a tree or one by one */
+void Startup()
+{
+    const int workers = 256;
+    cout << "startup: " << workers << " persistent workers, each run twice" << endl;
+    cout << "stack               run   total [us]   per worker [us]   virtual [kB]   resident [kB]" << endl;
+    const char* names[] = { "default ( 8 MB )   ", "64 kB              ", "64 kB, no guard    ", "64 kB, one by one  " };
+    for (int mode = 0; mode < 4; ++mode) {
+        for (int run = 1; run <= 2; ++run) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(true);
+            if (mode)
+                pool.setStackSize(64 * 1024, mode != 2);
+            if (mode == 3)
+                pool.setStartupFanout(1);
+            for (int i = 0; i < workers; ++i)
+                pool.addThread(new SpinThread(10));
+            pool.StartAndWait();
+            const auto& startup = pool.Startup();
+            cout << names[mode] << setw(4) << run << fixed << setprecision(1) << setw(13) << startup.microseconds << setw(18) << startup.microseconds / workers
+                 << setw(15) << startup.virtual_bytes / 1024 << setw(16) << startup.resident_bytes / 1024 << endl;
+            cout.unsetf(std::ios_base::floatfield);
+        }
+    }
+}
+
+/* Shared queue accesses and throughput of tiny jobs with many workers */
+void Batch()
+{
+    const int jobs = 100000;
+    cout << "batch: " << jobs << " jobs of about a microsecond" << endl;
+    cout << "mode                 workers   queue ops/job      jobs/s" << endl;
+    for (int workers : { 64, 128 }) {
+        for (int persistent = 0; persistent < 2; ++persistent) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(persistent);
+            pool.setAdaptiveBatching(!persistent);
+            for (int i = 0; i < jobs; ++i)
+                pool.addThread(new SpinThread(500));
+            auto begin = std::chrono::steady_clock::now();
+            pool.StartAndWait();
+            double seconds = Seconds(begin);
+            /* thread per batch takes the jobs from the queue in the master thread only */
+            cout << (persistent ? "persistent workers " : "thread per batch   ") << setw(10) << workers << setw(16);
+            if (persistent)
+                cout << pool.QueueOperationsPerJob();
+            else
+                cout << "-";
+            cout << setw(12) << int(pool.Finished().size() / seconds) << endl;
+        }
+    }
+}
+
+/* Job owning a buffer that has to be freed on teardown */
+class BufferThread : public CxxThread {
+public:
+    BufferThread(int bytes)
+        : m_buffer(bytes, 1)
+    {
+    }
+
+    inline int execute()
+    {
+        return m_buffer[0];
+    }
+
+private:
+    std::vector<char> m_buffer;
+};
+
+/* Time spent in clear() and until all jobs are deleted, for each teardown mode and for jobs from an arena */
+void Teardown()
+{
+    const int jobs = 200000, bytes = 2048;
+    cout << "teardown: " << jobs << " queued jobs owning " << bytes << " bytes each" << endl;
+    cout << "mode           clear() [ms]   deleted [ms]" << endl;
+    const char* names[] = { "serial       ", "parallel     ", "background   ", "arena        " };
+    for (int mode = 0; mode < 4; ++mode) {
+        CxxThreadArena arena;
+        CxxThreadPool pool;
+        pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+        if (mode < 3)
+            pool.setTeardown(CxxThreadPool::TeardownMode(mode));
+        for (int i = 0; i < jobs; ++i)
+            pool.addThread(mode == 3 ? arena.Create<BufferThread>(bytes) : new BufferThread(bytes));
+        auto begin = std::chrono::steady_clock::now();
+        pool.clear();
+        double clear = Seconds(begin);
+        pool.WaitReclaimed();
+        arena.Release();
+        cout << names[mode] << fixed << setprecision(1) << setw(15) << clear * 1e3 << setw(15) << Seconds(begin) * 1e3 << endl;
+        cout.unsetf(std::ios_base::floatfield);
+    }
+}
+
+/* Heap allocations of queueing, running and finishing jobs once the pool is warmed up, the allocations per run
+ * must not depend on the number of jobs with preallocation */
+void Allocations()
+{
+    const int jobs = 20000, workers = 4;
+    cout << "allocations: runs of " << jobs / 4 << " and " << jobs << " jobs after two warm up runs, " << workers << " workers" << endl;
+    cout << "mode                preallocation   small run   large run   per job   zero" << endl;
+    std::vector<SpinThread*> threads;
+    for (int i = 0; i < jobs; ++i) {
+        threads.push_back(new SpinThread(100));
+        threads.back()->setAutoDelete(false);
+    }
+    for (int persistent = 0; persistent < 2; ++persistent) {
+        for (int preallocate = 0; preallocate < 2; ++preallocate) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(persistent);
+            if (preallocate)
+                pool.setPreallocation(jobs);
+            long long counts[2];
+            for (int run = 0; run < 4; ++run) {
+                int size = run % 2 ? jobs / 4 : jobs;
+                long long before = allocations.load();
+                for (int i = 0; i < size; ++i) {
+                    threads[i]->reset();
+                    pool.addThread(threads[i]);
+                }
+                pool.StartAndWait();
+                if (run >= 2)
+                    counts[run % 2] = allocations.load() - before;
+                pool.clear();
+            }
+            double per_job = double(counts[0] - counts[1]) / (jobs - jobs / 4);
+            cout << (persistent ? "persistent workers " : "thread per job     ") << setw(14) << (preallocate ? "on" : "off")
+                 << setw(12) << counts[1] << setw(12) << counts[0] << fixed << setprecision(2) << setw(10) << per_job << setw(7) << (counts[0] == counts[1] ? "yes" : "no") << endl;
+            cout.unsetf(std::ios_base::floatfield);
+            if (preallocate)
+                Check(counts[0] == counts[1], std::string("no allocation per job with preallocation, ") + (persistent ? "persistent workers" : "thread per job"));
+        }
+    }
+    for (auto thread : threads)
+        delete thread;
+}
+
+/* Job writing two lines through a locked and flushed stream, like the former verbose mode did for every job */
+class SyncLogThread : public CxxThread {
+public:
+    SyncLogThread(std::ostream* stream, std::mutex* mutex)
+        : m_stream(stream)
+        , m_mutex(mutex)
+    {
+    }
+
+    inline int execute()
+    {
+        {
+            std::lock_guard<std::mutex> lock(*m_mutex);
+            *m_stream << "Thread " << this << " is up and running." << std::endl;
+        }
+        for (int i = 0; i < 500; ++i)
+            m_value += i * 0.5;
+        std::lock_guard<std::mutex> lock(*m_mutex);
+        *m_stream << "Thread " << this << " finished." << std::endl;
+        return 0;
+    }
+
+private:
+    std::ostream* m_stream;
+    std::mutex* m_mutex;
+    volatile double m_value = 0;
+};
+
+/* Throughput of small jobs on persistent workers without log, with the asynchronous trace log and with synchronous writes */
+void Logger()
+{
+    const int jobs = 100000, workers = 4;
+    cout << "logger: " << jobs << " jobs on " << workers << " persistent workers, log written to /dev/null" << endl;
+    cout << "log                jobs/s   dropped" << endl;
+    std::ofstream null("/dev/null");
+    std::mutex mutex;
+    CxxLogger& logger = CxxLogger::Instance();
+    CxxLogger::Level level = logger.LogLevel();
+    logger.setStream(&null);
+    logger.setCapacity(1 << 16);
+    const char* names[] = { "off             ", "async trace     ", "synchronous     " };
+    for (int mode = 0; mode < 3; ++mode) {
+        logger.setLevel(mode == 1 ? CxxLogger::Level::Trace : CxxLogger::Level::Off);
+        CxxThreadPool pool;
+        pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+        pool.setActiveThreadCount(workers);
+        pool.setPersistentWorkers(true);
+        for (int i = 0; i < jobs; ++i)
+            pool.addThread(mode == 2 ? static_cast<CxxThread*>(new SyncLogThread(&null, &mutex)) : new SpinThread(500));
+        long long dropped = logger.Dropped();
+        auto begin = std::chrono::steady_clock::now();
+        pool.StartAndWait();
+        double seconds = Seconds(begin);
+        logger.Flush();
+        cout << names[mode] << setw(10) << int(jobs / seconds) << setw(10) << logger.Dropped() - dropped << endl;
+    }
+    logger.setLevel(level);
+    logger.setStream(&std::cout);
+}
+
+/* Job that works for a while, sending a heartbeat every period unless it hangs */
+class HeartbeatThread : public CxxThread {
+public:
+    HeartbeatThread(int milliseconds, int period, bool hang)
+        : m_milliseconds(milliseconds)
+        , m_period(period)
+        , m_hang(hang)
+    {
+    }
+
+    inline int execute()
+    {
+        for (int elapsed = 0; elapsed < m_milliseconds; elapsed += m_period) {
+            if (!m_hang)
+                heartbeat();
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_period));
+        }
+        return 0;
+    }
+
+private:
+    int m_milliseconds, m_period;
+    bool m_hang;
+};
+
+/* Detection latency of hanging jobs among jobs sending heartbeats, and the cost of a heartbeat */
+void Stall()
+{
+    const int workers = 4, timeout = 50;
+    cout << "stall: 4 hanging jobs of 300 ms next to 12 jobs with a heartbeat every 10 ms, stall timeout " << timeout << " ms" << endl;
+    cout << "mode                 reported   false   latency p50 [ms]   p99 [ms]" << endl;
+    for (int persistent = 0; persistent < 2; ++persistent) {
+        CxxThreadPool pool;
+        pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+        pool.setActiveThreadCount(workers);
+        pool.setPersistentWorkers(persistent);
+        std::vector<double> latencies;
+        std::unordered_set<const CxxThread*> hanging;
+        int wrong = 0;
+        pool.setStallTimeout(timeout, [&latencies, &hanging, &wrong, timeout](const CxxThreadPool::Stall& stall) {
+            latencies.push_back(stall.silent - timeout);
+            wrong += hanging.count(stall.thread) == 0;
+        });
+        for (int i = 0; i < 16; ++i) {
+            HeartbeatThread* thread = new HeartbeatThread(300, 10, i % 4 == 0);
+            pool.addThread(thread);
+            if (i % 4 == 0)
+                hanging.insert(thread);
+        }
+        pool.StartAndWait();
+        cout << (persistent ? "persistent workers " : "thread per job     ") << setw(10) << pool.Stalls().size() << setw(8) << wrong
+             << setw(19) << fixed << setprecision(2) << Percentile(latencies, 0.5) << setw(11) << Percentile(latencies, 0.99) << endl;
+        cout.unsetf(std::ios_base::floatfield);
+    }
+    HeartbeatThread thread(0, 1, false);
+    const int beats = 10000000;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < beats; ++i)
+        thread.heartbeat();
+    cout << "heartbeat: " << fixed << setprecision(1) << Seconds(begin) * 1e9 / beats << " ns per call" << endl;
+    cout.unsetf(std::ios_base::floatfield);
+}
+
+struct GatherNode {
+    double value;
+    double padding[7]; /* one node per cache line */
+};
+
+/* Job following pointers to nodes scattered over a large array, some work per node */
+class GatherThread : public CxxThread {
+public:
+    GatherThread(std::vector<const GatherNode*> nodes, int work)
+        : m_nodes(std::move(nodes))
+        , m_work(work)
+    {
+    }
+
+    inline int execute()
+    {
+        double sum = 0;
+        for (const auto* node : m_nodes) {
+            double x = node->value;
+            for (int i = 0; i < m_work; ++i)
+                x = x * 0.999 + 0.5;
+            sum += x;
+        }
+        m_sum = sum;
+        return 0;
+    }
+
+    void prefetch() const override
+    {
+        CxxPrefetch::Range(m_nodes.data(), m_nodes.size() * sizeof(GatherNode*));
+        for (const auto* node : m_nodes)
+            CxxPrefetch::Read(node);
+    }
+
+private:
+    std::vector<const GatherNode*> m_nodes;
+    int m_work;
+    volatile double m_sum = 0;
+};
+
+/* Throughput of jobs with cold input on persistent workers, without and with prefetching the next job */
+void Prefetch()
+{
+    const std::size_t count = std::size_t(1) << 22;
+    const int jobs = 20000, nodes = 64, work = 20;
+    cout << "prefetch: " << jobs << " jobs gathering " << nodes << " random nodes of a " << count * sizeof(GatherNode) / (1 << 20) << " MB array" << endl;
+    cout << "pool                 distance   jobs/s   speedup" << endl;
+    std::vector<GatherNode> array(count);
+    for (std::size_t i = 0; i < count; ++i)
+        array[i].value = i % 7;
+    std::mt19937_64 random(42);
+    for (int workers = 1; workers <= 4; workers *= 4) {
+        double reference = 0;
+        for (int distance = 0; distance < 3; ++distance) {
+            CxxThreadPool pool;
+            pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+            pool.setActiveThreadCount(workers);
+            pool.setPersistentWorkers(true);
+            pool.setPrefetchDistance(distance);
+            for (int i = 0; i < jobs; ++i) {
+                std::vector<const GatherNode*> input(nodes);
+                for (auto& node : input)
+                    node = &array[random() % count];
+                pool.addThread(new GatherThread(std::move(input), work));
+            }
+            auto begin = std::chrono::steady_clock::now();
+            pool.StartAndWait();
+            double rate = jobs / Seconds(begin);
+            if (distance == 0)
+                reference = rate;
+            cout << "workers " << workers << "          " << setw(10) << distance << setw(9) << int(rate) << setw(10) << fixed << setprecision(2) << rate / reference << endl;
+            cout.unsetf(std::ios_base::floatfield);
+        }
+    }
+}
+
+/* Job alternating between sending to one channel and receiving from another, suspends while it can not go on */
+class PingThread : public CxxThread {
+public:
+    PingThread(CxxChannel<int>* out, CxxChannel<int>* in, int rounds, bool sender)
+        : m_out(out)
+        , m_in(in)
+        , m_steps(2 * rounds)
+        , m_sender(sender)
+    {
+    }
+
+    inline int execute()
+    {
+        for (; m_step < m_steps; ++m_step) {
+            int value = m_step;
+            if ((m_step % 2 == 0) == m_sender) {
+                if (!m_out->TrySend(value))
+                    return suspend(*m_out, CxxChannel<int>::Sendable);
+            } else if (!m_in->TryReceive(value))
+                return suspend(*m_in, CxxChannel<int>::Receivable);
+        }
+        return 0;
+    }
+
+private:
+    CxxChannel<int>*m_out, *m_in;
+    int m_steps, m_step = 0;
+    bool m_sender;
+};
+
+/* Producer and consumer jobs streaming values through a channel */
+class ProducerThread : public CxxThread {
+public:
+    ProducerThread(CxxChannel<int>* out, int count)
+        : m_out(out)
+        , m_count(count)
+    {
+    }
+
+    inline int execute()
+    {
+        for (; m_sent < m_count; ++m_sent)
+            if (!m_out->TrySend(m_sent))
+                return suspend(*m_out, CxxChannel<int>::Sendable);
+        m_out->Close();
+        return 0;
+    }
+
+private:
+    CxxChannel<int>* m_out;
+    int m_count, m_sent = 0;
+};
+
+class ConsumerThread : public CxxThread {
+public:
+    ConsumerThread(CxxChannel<int>* in)
+        : m_in(in)
+    {
+    }
+
+    inline int execute()
+    {
+        int value = 0;
+        while (true) {
+            if (m_in->TryReceive(value)) {
+                m_sum += value;
+                continue;
+            }
+            if (m_in->Drained())
+                return 0;
+            return suspend(*m_in, CxxChannel<int>::Receivable);
+        }
+    }
+
+    inline long long Sum() const { return m_sum; }
+
+private:
+    CxxChannel<int>* m_in;
+    long long m_sum = 0;
+};
+
+/* Round trip latency and streaming throughput between jobs on channels, against two threads blocking on the channels */
+void Channel()
+{
+    const int rounds = 20000, values = 200000;
+    cout << "channel: ping-pong of " << rounds << " round trips, " << values << " values through a channel of capacity 64" << endl;
+    cout << "mode                   round trip [us]   values/s" << endl;
+    const char* names[] = { "persistent workers, 1 ", "persistent workers, 2 ", "thread per job, 2     ", "blocking threads      " };
+    for (int mode = 0; mode < 4; ++mode) {
+        /* suspended jobs resume in a new thread each time in thread per job mode */
+        int trips = mode == 2 ? rounds / 20 : rounds;
+        double trip = 0, rate = 0;
+        for (int test = 0; test < 2; ++test) {
+            CxxChannel<int> a(test ? 64 : 1), b(1);
+            std::unique_ptr<ConsumerThread> consumer;
+            auto begin = std::chrono::steady_clock::now();
+            if (mode == 3) {
+                std::thread other;
+                if (test == 0) {
+                    other = std::thread([&a, &b, trips]() {
+                        int value = 0;
+                        for (int i = 0; i < trips; ++i)
+                            a.Receive(value), b.Send(value);
+                    });
+                    int value = 0;
+                    for (int i = 0; i < trips; ++i)
+                        a.Send(i), b.Receive(value);
+                } else {
+                    other = std::thread([&a, values]() {
+                        for (int i = 0; i < values; ++i)
+                            a.Send(i);
+                        a.Close();
+                    });
+                    int value = 0;
+                    while (a.Receive(value))
+                        ;
+                }
+                other.join();
+            } else {
+                CxxThreadPool pool;
+                pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+                pool.setActiveThreadCount(mode == 0 ? 1 : 2);
+                pool.setPersistentWorkers(mode < 2);
+                if (test == 0) {
+                    pool.addThread(new PingThread(&a, &b, trips, true));
+                    pool.addThread(new PingThread(&b, &a, trips, false));
+                } else {
+                    consumer.reset(new ConsumerThread(&a));
+                    consumer->setAutoDelete(false);
+                    pool.addThread(new ProducerThread(&a, mode == 2 ? values / 20 : values));
+                    pool.addThread(consumer.get());
+                }
+                begin = std::chrono::steady_clock::now();
+                pool.StartAndWait();
+            }
+            if (test == 0)
+                trip = Seconds(begin) * 1e6 / trips;
+            else
+                rate = (mode == 2 ? values / 20 : values) / Seconds(begin);
+        }
+        cout << names[mode] << setw(18) << fixed << setprecision(2) << trip << setw(11) << int(rate) << endl;
+        cout.unsetf(std::ios_base::floatfield);
+    }
+}
+
+/* Job passing phases of a phaser, either suspending until a phase ended or blocking its worker */
+class PhaseThread : public CxxThread {
+public:
+    PhaseThread(CxxPhaser* phaser, int phases, bool blocking)
+        : m_phaser(phaser)
+        , m_phases(phases)
+        , m_blocking(blocking)
+    {
+    }
+
+    inline int execute()
+    {
+        for (; m_passed < m_phases; ++m_passed) {
+            if (m_blocking) {
+                if (!m_phaser->ArriveAndWait())
+                    return 1;
+                continue;
+            }
+            if (!m_arrived) {
+                m_phase = m_phaser->Arrive();
+                m_arrived = true;
+            }
+            if (!m_phaser->Passed(m_phase))
+                return suspend(*m_phaser, m_phase);
+            m_arrived = false;
+        }
+        return 0;
+    }
+
+private:
+    CxxPhaser* m_phaser;
+    int m_phases, m_passed = 0, m_phase = 0;
+    bool m_blocking, m_arrived = false;
+};
+
+/* Time per phase of a barrier with 2 to 128 parties: suspending jobs and blocking jobs on 4 persistent workers,
+ * the latter refused beyond the concurrency of the pool, and blocking threads */
+void Barrier()
+{
+    const int phases = 200, workers = 4;
+    cout << "barrier: " << phases << " phases, jobs on " << workers << " persistent workers" << endl;
+    cout << "parties   suspending jobs [us]   blocking jobs [us]   threads [us]" << endl;
+    for (int parties = 2; parties <= 128; parties *= 2) {
+        double times[3] = { 0, 0, 0 };
+        bool refused = false;
+        for (int mode = 0; mode < 3; ++mode) {
+            CxxPhaser phaser(parties);
+            auto begin = std::chrono::steady_clock::now();
+            if (mode == 2) {
+                std::vector<std::thread> threads;
+                for (int i = 0; i < parties; ++i)
+                    threads.push_back(std::thread([&phaser]() {
+                        for (int phase = 0; phase < phases; ++phase)
+                            phaser.ArriveAndWait();
+                    }));
+                for (auto& thread : threads)
+                    thread.join();
+            } else {
+                CxxThreadPool pool;
+                pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+                pool.setActiveThreadCount(workers);
+                pool.setPersistentWorkers(true);
+                phaser.setConcurrency(pool.Concurrency());
+                for (int i = 0; i < parties; ++i)
+                    pool.addThread(new PhaseThread(&phaser, phases, mode == 1));
+                begin = std::chrono::steady_clock::now();
+                pool.StartAndWait();
+                if (mode == 1)
+                    for (const auto* thread : pool.Finished())
+                        refused = refused || thread->Return() != 0;
+            }
+            times[mode] = Seconds(begin) * 1e6 / phases;
+        }
+        cout << setw(7) << parties << setw(23) << fixed << setprecision(2) << times[0];
+        if (refused)
+            cout << setw(21) << "refused";
+        else
+            cout << setw(21) << times[1];
+        cout << setw(15) << times[2] << endl;
+        cout.unsetf(std::ios_base::floatfield);
+    }
+}
+
+#if defined(__linux__)
+/* Writes a fake sysfs tree, removed again on destruction */
+class FakeSysfs {
+public:
+    FakeSysfs()
+    {
+        char root[] = "/tmp/cxxsysfsXXXXXX";
+        if (mkdtemp(root))
+            m_root = root;
+    }
+
+    ~FakeSysfs()
+    {
+        for (auto path = m_paths.rbegin(); path != m_paths.rend(); ++path)
+            std::remove(path->c_str());
+        if (m_root.size())
+            std::remove(m_root.c_str());
+    }
+
+    inline const std::string& Root() const { return m_root; }
+
+    /* creates the missing directories of path */
+    void Write(const std::string& path, const std::string& content)
+    {
+        for (std::size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+            std::string directory = m_root + "/" + path.substr(0, slash);
+            if (mkdir(directory.c_str(), 0755) == 0)
+                m_paths.push_back(directory);
+        }
+        std::ofstream file(m_root + "/" + path);
+        file << content << "\n";
+        m_paths.push_back(m_root + "/" + path);
+    }
+
+private:
+    std::string m_root;
+    std::vector<std::string> m_paths;
+};
+#endif
+
+/* CxxTopology on a fake hybrid machine: two P-cores with two hyper threads each and four E-cores sharing an L2 cache
+ * ( capacity 512 of 1024 ), and the static blocks of ten threads planned on it */
+void Topology()
+{
+#if defined(__linux__)
+    cout << "topology: fake sysfs with 4 P-core threads and 4 E-cores" << endl;
+    FakeSysfs sysfs;
+    Check(sysfs.Root().size(), "temporary directory");
+    if (sysfs.Root().empty())
+        return;
+    const std::string cpu_root = "devices/system/cpu/";
+    sysfs.Write(cpu_root + "online", "0-7");
+    for (int cpu = 0; cpu < 8; ++cpu) {
+        bool performance = cpu < 4;
+        std::string path = cpu_root + "cpu" + std::to_string(cpu) + "/";
+        std::string siblings = performance ? std::to_string(cpu & ~1) + "-" + std::to_string(cpu | 1) : std::to_string(cpu);
+        sysfs.Write(path + "topology/thread_siblings_list", siblings);
+        sysfs.Write(path + "topology/physical_package_id", "0");
+        sysfs.Write(path + "cache/index0/level", "1");
+        sysfs.Write(path + "cache/index0/type", "Data");
+        sysfs.Write(path + "cache/index0/shared_cpu_list", siblings);
+        sysfs.Write(path + "cache/index1/level", "1");
+        sysfs.Write(path + "cache/index1/type", "Instruction");
+        sysfs.Write(path + "cache/index1/shared_cpu_list", siblings);
+        sysfs.Write(path + "cache/index2/level", "2");
+        sysfs.Write(path + "cache/index2/type", "Unified");
+        sysfs.Write(path + "cache/index2/shared_cpu_list", performance ? siblings : "4-7");
+        sysfs.Write(path + "cache/index3/level", "3");
+        sysfs.Write(path + "cache/index3/type", "Unified");
+        sysfs.Write(path + "cache/index3/shared_cpu_list", "0-7");
+        sysfs.Write(path + "cpu_capacity", performance ? "1024" : "512");
+    }
+    sysfs.Write("devices/cpu_core/cpus", "0-3");
+    sysfs.Write("devices/cpu_atom/cpus", "4-7");
+    sysfs.Write("devices/system/node/online", "0");
+    sysfs.Write("devices/system/node/node0/cpulist", "0-7");
+
+    Check(CxxTopology::ParseList("0-2,5,7-8") == std::vector<int>({ 0, 1, 2, 5, 7, 8 }), "ParseList");
+    CxxTopology topology;
+    Check(topology.Load(sysfs.Root()), "Load");
+    Check(topology.Cpus() == std::vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7 }), "online CPUs");
+    Check(topology.Hybrid(), "Hybrid");
+    Check(topology.Type(1) == CxxTopology::Performance && topology.Type(6) == CxxTopology::Efficiency, "core types");
+    Check(std::abs(topology.Capacity(3) - 1) < 1e-9 && std::abs(topology.Capacity(4) - 0.5) < 1e-9, "capacities");
+    Check(topology.Distance(0, 1) == CxxTopology::SMT, "distance of hyper threads");
+    Check(topology.Distance(4, 7) == CxxTopology::L2, "distance of E-cores");
+    Check(topology.Distance(1, 2) == CxxTopology::L3 && topology.Distance(0, 5) == CxxTopology::L3, "distance of cores");
+
+    /* CPUs 0 and 1 get two blocks each, together as many jobs as the blocks of CPUs 2 and 3 */
+    const int jobs = 600;
+    CxxThreadPool pool;
+    pool.setProgressBar(CxxThreadPool::ProgressBarType::None);
+    pool.setActiveThreadCount(10);
+    pool.setSysfsRoot(sysfs.Root());
+    pool.setHybridScheduling(true);
+    for (int i = 0; i < jobs; ++i)
+        pool.addThread(new SpinThread(10));
+    pool.StaticPool();
+    std::map<int, int> per_cpu;
+    for (std::size_t i = 0; i < pool.PendingJobs().size(); ++i)
+        per_cpu[pool.PendingJobs()[i]->PreferredCpu()] += static_cast<CxxBlockedThread*>(pool.PendingJobs()[i])->Threads().size();
+    cout << "cpu   capacity   jobs" << endl;
+    for (const auto& cpu : per_cpu)
+        cout << setw(3) << cpu.first << setw(11) << topology.Capacity(cpu.first) << setw(7) << cpu.second << endl;
+    for (const auto& cpu : per_cpu)
+        Check(std::abs(cpu.second - jobs * topology.Capacity(cpu.first) / 6) <= 2, "jobs of the blocks on cpu " + std::to_string(cpu.first));
+    pool.StartAndWait();
+    Check(int(pool.Finished().size()) == jobs, "jobs run");
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    const char* name = argc > 1 ? argv[1] : "";
+    bool all = strlen(name) == 0;
+    if (all || strcmp(name, "batch") == 0)
+        Batch();
+    if (all || strcmp(name, "locality") == 0)
+        Locality();
+    if (all || strcmp(name, "urgent") == 0)
+        Urgent();
+    if (all || strcmp(name, "deadline") == 0)
+        Deadline();
+    if (all || strcmp(name, "tenant") == 0)
+        Tenant();
+    if (all || strcmp(name, "rate") == 0)
+        Rate();
+    if (all || strcmp(name, "eco") == 0)
+        Eco();
+    if (all || strcmp(name, "nice") == 0)
+        Nice();
+    if (all || strcmp(name, "startup") == 0)
+        Startup();
+    if (all || strcmp(name, "teardown") == 0)
+        Teardown();
+    if (all || strcmp(name, "allocations") == 0)
+        Allocations();
+    if (all || strcmp(name, "logger") == 0)
+        Logger();
+    if (all || strcmp(name, "stall") == 0)
+        Stall();
+    if (all || strcmp(name, "prefetch") == 0)
+        Prefetch();
+    if (all || strcmp(name, "channel") == 0)
+        Channel();
+    if (all || strcmp(name, "barrier") == 0)
+        Barrier();
+    if (all || strcmp(name, "topology") == 0)
+        Topology();
+    return failures ? 1 : 0;
+}
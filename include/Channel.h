@@ -0,0 +1,219 @@
+/*
+ * <Bounded channels between CxxThreadPool jobs.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Ring.h"
+
+class CxxThread;
+
+/*! \brief Condition a job can wait for without holding a worker, see CxxThread::suspend() */
+class CxxWaitable {
+public:
+    typedef std::function<void(CxxThread*)> Resume;
+
+    virtual ~CxxWaitable() = default;
+
+    /*! \brief Called by the pool once a suspended job has returned from execute()
+     * resume( thread ) has to be called exactly once when the event may have happened, at once if it already has */
+    virtual void Park(CxxThread* thread, int event, const Resume& resume) = 0;
+
+    /*! \brief Forget a parked job, returns false if it is not parked ( any more ), for example as it is being resumed */
+    virtual bool Cancel(CxxThread* thread) = 0;
+};
+
+/*! \brief Bounded multi producer, multi consumer channel, guarded by a mutex
+ * Jobs use TrySend() and TryReceive() and suspend on Sendable or Receivable if they fail, so that the worker runs other
+ * jobs meanwhile; every successful send resumes one waiting receiver and vice versa. Threads outside the pool may block in
+ * Send() and Receive(). After Close() sending fails and receiving fails once the channel is empty */
+template <class T>
+class CxxChannel : public CxxWaitable {
+public:
+    enum Event {
+        Receivable = 0, /* a value is available or the channel is closed */
+        Sendable = 1 /* there is room or the channel is closed */
+    };
+
+    explicit CxxChannel(std::size_t capacity = 1)
+        : m_capacity(std::max<std::size_t>(capacity, 1))
+    {
+        m_buffer.reserve(m_capacity);
+    }
+
+    CxxChannel(const CxxChannel&) = delete;
+    CxxChannel& operator=(const CxxChannel&) = delete;
+
+    /*! \brief Put value into the channel, false if it is full or closed */
+    bool TrySend(const T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_closed || m_buffer.size() == m_capacity)
+            return false;
+        m_buffer.push(value);
+        Wake(m_receivers, m_receivable, lock);
+        return true;
+    }
+
+    /*! \brief Take the oldest value from the channel, false if it is empty */
+    bool TryReceive(T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_buffer.empty())
+            return false;
+        value = std::move(m_buffer.front());
+        m_buffer.pop();
+        Wake(m_senders, m_sendable, lock);
+        return true;
+    }
+
+    /*! \brief Wait for room and put value into the channel, false if the channel is closed; blocks the calling thread */
+    bool Send(const T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sendable.wait(lock, [this]() { return m_closed || m_buffer.size() < m_capacity; });
+        if (m_closed)
+            return false;
+        m_buffer.push(value);
+        Wake(m_receivers, m_receivable, lock);
+        return true;
+    }
+
+    /*! \brief Wait for a value, false if the channel is closed and empty; blocks the calling thread */
+    bool Receive(T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_receivable.wait(lock, [this]() { return m_closed || !m_buffer.empty(); });
+        if (m_buffer.empty())
+            return false;
+        value = std::move(m_buffer.front());
+        m_buffer.pop();
+        Wake(m_senders, m_sendable, lock);
+        return true;
+    }
+
+    /*! \brief Refuse further values and resume all waiting jobs and threads */
+    void Close()
+    {
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            for (auto queue : { &m_receivers, &m_senders })
+                while (queue->size()) {
+                    waiters.push_back(queue->front());
+                    queue->pop();
+                }
+        }
+        m_receivable.notify_all();
+        m_sendable.notify_all();
+        for (auto& waiter : waiters)
+            waiter.resume(waiter.thread);
+    }
+
+    inline bool Closed() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+
+    /*! \brief True once the channel is closed and all values were received */
+    inline bool Drained() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed && m_buffer.empty();
+    }
+
+    inline std::size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_buffer.size();
+    }
+    inline std::size_t Capacity() const { return m_capacity; }
+
+    void Park(CxxThread* thread, int event, const Resume& resume) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool ready = m_closed || (event == Receivable ? !m_buffer.empty() : m_buffer.size() < m_capacity);
+        if (!ready) {
+            (event == Receivable ? m_receivers : m_senders).push(Waiter { thread, resume });
+            return;
+        }
+        lock.unlock();
+        resume(thread);
+    }
+
+    bool Cancel(CxxThread* thread) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto queue : { &m_receivers, &m_senders }) {
+            for (std::size_t i = 0; i < queue->size(); ++i) {
+                if ((*queue)[i].thread != thread)
+                    continue;
+                /* keep the order of the other waiters */
+                for (std::size_t j = i; j + 1 < queue->size(); ++j)
+                    (*queue)[j] = (*queue)[j + 1];
+                queue->pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Waiter {
+        CxxThread* thread;
+        Resume resume;
+    };
+
+    /* One waiting job per value or free slot, resumed after the lock is released; blocked threads are notified as well */
+    void Wake(CxxRing<Waiter>& waiters, std::condition_variable& condition, std::unique_lock<std::mutex>& lock)
+    {
+        if (waiters.empty()) {
+            lock.unlock();
+            condition.notify_one();
+            return;
+        }
+        Waiter waiter = waiters.front();
+        waiters.pop();
+        lock.unlock();
+        condition.notify_one();
+        waiter.resume(waiter.thread);
+    }
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_receivable, m_sendable;
+    CxxRing<T> m_buffer;
+    CxxRing<Waiter> m_receivers, m_senders;
+    std::size_t m_capacity;
+    bool m_closed = false;
+};
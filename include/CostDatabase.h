@@ -0,0 +1,219 @@
+/*
+ * <Persistent runtime database for CxxThreadPool jobs.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*! \brief Runtimes of jobs, stored across processes in a memory mapped open addressing hash table
+ * The key is the hashed signature of a job ( CxxThread::Signature() ), the value an exponentially
+ * smoothed runtime in milliseconds. Only one process should update a database file at a time.
+ * Without POSIX the table is kept in memory only and lives as long as the object. */
+class CxxCostDatabase {
+public:
+    CxxCostDatabase() = default;
+    ~CxxCostDatabase() { Close(); }
+
+    CxxCostDatabase(const CxxCostDatabase&) = delete;
+    CxxCostDatabase& operator=(const CxxCostDatabase&) = delete;
+
+    /*! \brief Open or create the database, capacity is rounded up to a power of two */
+    bool Open(const std::string& filename, std::uint64_t capacity = 1 << 16)
+    {
+        Close();
+#if defined(__unix__) || defined(__APPLE__)
+        m_file = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_file < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(m_file, &status) != 0) {
+            Close();
+            return false;
+        }
+        if (status.st_size >= std::int64_t(sizeof(Header))) {
+            Header header;
+            if (pread(m_file, &header, sizeof(Header), 0) == sizeof(Header) && header.magic == Magic
+                && status.st_size >= std::int64_t(FileSize(header.capacity)))
+                return Map(header.capacity, false);
+        }
+#endif
+        std::uint64_t size = 1024;
+        while (size < capacity)
+            size <<= 1;
+        return Map(size, true);
+    }
+
+    void Close()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (m_header) {
+            msync(m_header, FileSize(m_header->capacity), MS_SYNC);
+            munmap(m_header, FileSize(m_header->capacity));
+        }
+        if (m_file >= 0)
+            close(m_file);
+#endif
+        m_memory.clear();
+        m_header = nullptr;
+        m_entries = nullptr;
+        m_file = -1;
+    }
+
+    inline bool isOpen() const { return m_header != nullptr; }
+
+    /*! \brief Weight of the latest runtime in the smoothed value, between 0 and 1 */
+    inline void setSmoothing(double alpha) { m_alpha = alpha; }
+    inline double Smoothing() const { return m_alpha; }
+
+    inline std::uint64_t Size() const { return m_header ? m_header->count : 0; }
+    inline std::uint64_t Capacity() const { return m_header ? m_header->capacity : 0; }
+
+    /*! \brief FNV-1a hash of a job signature, 0 is reserved for empty slots */
+    static std::uint64_t Hash(const std::string& signature)
+    {
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : signature) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash ? hash : 1;
+    }
+
+    bool Lookup(std::uint64_t key, double& cost) const
+    {
+        if (!m_header || key == 0)
+            return false;
+        const Entry* entry = Find(m_entries, m_header->capacity, key);
+        if (entry->key != key)
+            return false;
+        cost = entry->cost;
+        return true;
+    }
+
+    /*! \brief Blend a new runtime into the stored value */
+    void Update(std::uint64_t key, double runtime)
+    {
+        if (!m_header || key == 0)
+            return;
+        if ((m_header->count + 1) * 10 > m_header->capacity * 7 && !Grow())
+            return;
+        Entry* entry = Find(m_entries, m_header->capacity, key);
+        if (entry->key != key) {
+            entry->key = key;
+            entry->cost = runtime;
+            entry->samples = 1;
+            m_header->count++;
+            return;
+        }
+        entry->cost = m_alpha * runtime + (1 - m_alpha) * entry->cost;
+        entry->samples++;
+    }
+
+private:
+    static const std::uint64_t Magic = 0x3174736f43787843ULL; /* "CxxCost1" */
+
+    struct Header {
+        std::uint64_t magic;
+        std::uint64_t capacity;
+        std::uint64_t count;
+        std::uint64_t reserved;
+    };
+
+    struct Entry {
+        std::uint64_t key;
+        double cost;
+        std::uint64_t samples;
+    };
+
+    static std::size_t FileSize(std::uint64_t capacity) { return sizeof(Header) + capacity * sizeof(Entry); }
+
+    /* Linear probing, returns the slot holding key or the first empty one */
+    static Entry* Find(Entry* entries, std::uint64_t capacity, std::uint64_t key)
+    {
+        std::uint64_t mask = capacity - 1;
+        std::uint64_t index = (key ^ (key >> 29)) & mask;
+        while (entries[index].key != 0 && entries[index].key != key)
+            index = (index + 1) & mask;
+        return &entries[index];
+    }
+
+    bool Map(std::uint64_t capacity, bool initialise)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (ftruncate(m_file, FileSize(capacity)) != 0)
+            return false;
+        void* memory = mmap(nullptr, FileSize(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+        if (memory == MAP_FAILED)
+            return false;
+#else
+        m_memory.assign(FileSize(capacity) / sizeof(std::uint64_t), 0);
+        void* memory = m_memory.data();
+#endif
+        m_header = static_cast<Header*>(memory);
+        m_entries = reinterpret_cast<Entry*>(static_cast<char*>(memory) + sizeof(Header));
+        if (initialise) {
+            std::memset(memory, 0, FileSize(capacity));
+            m_header->magic = Magic;
+            m_header->capacity = capacity;
+        }
+        return true;
+    }
+
+    bool Grow()
+    {
+        std::uint64_t capacity = m_header->capacity;
+        std::vector<Entry> entries(m_entries, m_entries + capacity);
+#if defined(__unix__) || defined(__APPLE__)
+        munmap(m_header, FileSize(capacity));
+#endif
+        m_header = nullptr;
+        m_entries = nullptr;
+        if (!Map(capacity * 2, true))
+            return false;
+        for (const auto& entry : entries) {
+            if (entry.key == 0)
+                continue;
+            *Find(m_entries, m_header->capacity, entry.key) = entry;
+            m_header->count++;
+        }
+        return true;
+    }
+
+    int m_file = -1;
+    std::vector<std::uint64_t> m_memory; /* the table without POSIX */
+    Header* m_header = nullptr;
+    Entry* m_entries = nullptr;
+    double m_alpha = 0.3;
+};
@@ -25,17 +25,58 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <queue>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
+#include "Channel.h"
+#include "CostDatabase.h"
+#include "Logger.h"
+#include "NativeThread.h"
+#include "Phaser.h"
+#include "Prefetch.h"
+#include "RateLimiter.h"
+#include "Ring.h"
+#include "Topology.h"
+#include "Trace.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 
 class CxxThread {
 public:
@@ -44,18 +85,22 @@ public:
 
     inline void start()
     {
-#ifdef _CxxThreadPool_Verbose
-        std::cout << "CxxThread::start() - Thread " << m_increment_id << " is up and running." << std::endl;
-#endif
+        CxxLogger::Instance().Log(CxxLogger::Level::Trace, "CxxThread::start() - Thread %lld is up and running.", m_increment_id);
         m_start = std::chrono::system_clock::now();
+        dispatched();
+#ifdef _CxxThreadPool_Trace
+        CxxTrace::Instance().Begin(this, m_increment_id, typeid(*this));
+#endif
         m_return = execute();
+#ifdef _CxxThreadPool_Trace
+        CxxTrace::Instance().End(this, m_increment_id, m_return);
+#endif
         m_running = false;
         m_finished = true;
         m_end = std::chrono::system_clock::now();
         m_time = std::chrono::duration_cast<std::chrono::milliseconds>(m_end - m_start).count();
-#ifdef _CxxThreadPool_Verbose
-        std::cout << "CxxThread::start() - Thread  " << m_increment_id << " finished after " << m_time << " mseconds." << std::endl;
-#endif
+        m_time_us = std::chrono::duration_cast<std::chrono::microseconds>(m_end - m_start).count();
+        CxxLogger::Instance().Log(CxxLogger::Level::Trace, "CxxThread::start() - Thread %lld finished after %lld mseconds.", m_increment_id, m_time);
     }
 
     inline bool Running() const
@@ -69,13 +114,56 @@ public:
     }
 
     virtual int execute() = 0;
-    void reset() { m_finished = false; }
+    /*! \brief Warm the input of the job ( see CxxPrefetch ), called by the thread that will run it while it runs the job before
+     * ( see CxxThreadPool::setPrefetchDistance ). It must not change the job and should return quickly */
+    virtual void prefetch() const {}
+    void reset()
+    {
+        m_finished = false;
+        m_shed = false;
+        m_wait = nullptr;
+    }
+    /*! \brief Give up the worker until waitable signals event ( for example CxxChannel::Receivable ), execute() returns the
+     * result right after. Once the event may have happened, the pool runs the job again as urgent job and execute() continues
+     * from the state kept in the job; the run ends only after all suspended jobs have finished. Jobs fused by adaptive
+     * batching may suspend. Blocked pools ( StaticPool(), DynamicPool() ) are not supported: a job suspending inside a
+     * block is logged as error and left unfinished ( Finished() is false ), its continuation never runs */
+    inline int suspend(CxxWaitable& waitable, int event)
+    {
+        m_wait = &waitable;
+        m_wait_event = event;
+        return 0;
+    }
+    inline CxxWaitable* Waiting() const { return m_wait; }
+    inline int WaitEvent() const { return m_wait_event; }
 
     inline bool AutoDelete() const { return m_autodelete; }
 
     inline void setAutoDelete(bool autodelete) { m_autodelete = autodelete; }
     inline void setIncrementId(int id) { m_increment_id = id; }
+    inline int IncrementId() const { return m_increment_id; }
+    /*! \brief Tell the stall monitor of the pool that the job is alive ( see CxxThreadPool::setStallTimeout )
+     * Jobs running longer than the stall timeout call it from execute() now and then; start() sets it as well */
+    inline void heartbeat() { m_heartbeat.store(SteadyNanoseconds()); }
+    /*! \brief Time of the last heartbeat in nanoseconds of the steady clock */
+    inline std::int64_t Heartbeat() const { return m_heartbeat.load(); }
+    /*! \brief Called by the pool when the job is handed to a worker and by start(), sets the heartbeat and the start of
+     * the runtime seen by the stall monitor, in nanoseconds of the steady clock */
+    inline void dispatched()
+    {
+        std::int64_t now = SteadyNanoseconds();
+        m_started.store(now);
+        m_heartbeat.store(now);
+    }
+    inline std::int64_t Started() const { return m_started.load(); }
+    static inline std::int64_t SteadyNanoseconds() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+    /*! \brief The job that is actually running, blocks of jobs return the job they are running */
+    virtual const CxxThread* Current() const { return this; }
     inline int Time() const { return m_time; }
+    /*! \brief Runtime of the last execution in microseconds */
+    inline long long TimeMicroseconds() const { return m_time_us; }
+    inline std::chrono::time_point<std::chrono::system_clock> StartTime() const { return m_start; }
+    inline std::chrono::time_point<std::chrono::system_clock> EndTime() const { return m_end; }
     virtual inline bool BreakThreadPool() const { return m_break_pool; }
 
     inline void setEnabled(bool enabled) { m_enabled = enabled; }
@@ -84,13 +172,91 @@ public:
     int ThreadId() const { return m_thread_id; }
     int Return() const { return m_return; }
 
+    /*! \brief Signature of the job for the persistent cost database, jobs with equal signatures are expected to take equally long
+     * The default ( empty ) signature excludes the job from the database */
+    virtual std::string Signature() const { return std::string(); }
+    /*! \brief Jobs with the same locality key touch the same data and are run back to back by the same worker if possible
+     * Negative keys ( default ) mean no preference */
+    inline void setLocalityKey(std::int64_t key) { m_locality_key = key; }
+    inline std::int64_t LocalityKey() const { return m_locality_key; }
+    /*! \brief Short or urgent jobs are run before all others and on reserved workers ( see CxxThreadPool::setReservedWorkers ) */
+    inline void setUrgent(bool urgent) { m_urgent = urgent; }
+    inline bool Urgent() const { return m_urgent; }
+    /*! \brief Time the job was handed to the pool, the queue latency is StartTime() - SubmitTime() */
+    inline void setSubmitTime(const std::chrono::time_point<std::chrono::system_clock>& time) { m_submit = time; }
+    inline std::chrono::time_point<std::chrono::system_clock> SubmitTime() const { return m_submit; }
+    /*! \brief Class of the job for per class rate limits ( see CxxThreadPool::setClassRateLimit ), negative ( default ) for none */
+    inline void setJobClass(int job_class) { m_job_class = job_class; }
+    inline int JobClass() const { return m_job_class; }
+    /*! \brief Tenant ( team or client ) the job is accounted to, tenants share the pool by weight ( see CxxThreadPool::setTenantWeight )
+     * Negative ( default ) for jobs in the common queue */
+    inline void setTenant(int tenant) { m_tenant = tenant; }
+    inline int Tenant() const { return m_tenant; }
+    /*! \brief Time by which the job has to be finished, jobs with a deadline are run earliest deadline first
+     * after the urgent jobs and before all jobs without deadline */
+    inline void setDeadline(const std::chrono::time_point<std::chrono::system_clock>& deadline)
+    {
+        m_deadline = deadline;
+        m_has_deadline = true;
+    }
+    inline std::chrono::time_point<std::chrono::system_clock> Deadline() const { return m_deadline; }
+    inline bool HasDeadline() const { return m_has_deadline; }
+    /*! \brief True if the job was not run, as it could not have met its deadline any more ( see CxxThreadPool::setDeadlineShedding ) */
+    inline void setShed(bool shed) { m_shed = shed; }
+    inline bool Shed() const { return m_shed; }
+    /*! \brief Jobs on the critical path are preferably run on P-cores with hybrid scheduling */
+    inline void setCritical(bool critical) { m_critical = critical; }
+    inline bool Critical() const { return m_critical; }
+    /*! \brief CPU the job should be pinned to when started in a thread of its own, negative for no pinning */
+    inline void setPreferredCpu(int cpu) { m_preferred_cpu = cpu; }
+    inline int PreferredCpu() const { return m_preferred_cpu; }
+    inline void setCostKey(std::uint64_t key) { m_cost_key = key; }
+    inline std::uint64_t CostKey() const { return m_cost_key; }
+    /*! \brief Runtime in milliseconds predicted from previous runs, negative if unknown */
+    inline void setPredictedCost(double cost) { m_predicted_cost = cost; }
+    inline double PredictedCost() const { return m_predicted_cost; }
+    /*! \brief Estimated cost of the job in arbitrary but common units, negative if unknown
+     * Used by StaticPool() and DynamicPool() to balance blocks, defaults to the predicted runtime */
+    virtual double Cost() const { return m_predicted_cost; }
+
 private:
     bool m_running = true, m_finished = false, m_enabled = true;
     bool m_autodelete = true;
     int m_return = 0;
-    std::chrono::time_point<std::chrono::system_clock> m_start, m_end;
+    std::chrono::time_point<std::chrono::system_clock> m_start, m_end, m_submit, m_deadline;
+    bool m_has_deadline = false, m_shed = false;
+    int m_tenant = -1, m_job_class = -1;
     int m_increment_id = 0;
     int m_time = 0;
+    long long m_time_us = 0;
+    std::uint64_t m_cost_key = 0;
+    std::int64_t m_locality_key = -1;
+    bool m_critical = false, m_urgent = false;
+    int m_preferred_cpu = -1;
+    double m_predicted_cost = -1;
+    CxxWaitable* m_wait = nullptr;
+    int m_wait_event = 0;
+
+    /* written by the job, read by the monitor of the pool; copyable, so that jobs stay copyable */
+    class Beat {
+    public:
+        Beat() = default;
+        Beat(const Beat& other)
+            : m_value(other.load())
+        {
+        }
+        Beat& operator=(const Beat& other)
+        {
+            store(other.load());
+            return *this;
+        }
+        inline void store(std::int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+        inline std::int64_t load() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::int64_t> m_value { 0 };
+    };
+    Beat m_heartbeat, m_started;
 
 protected:
     int m_thread_id = 0;
@@ -106,7 +272,17 @@ public:
     {
         for (int i = 0; i < m_threads.size(); ++i)
             if (m_threads[i]->isEnabled()) {
-                m_threads[i]->execute();
+                m_threads[i]->dispatched();
+                m_current.store(m_threads[i], std::memory_order_release);
+                /* the next job of the block runs on this thread as well, its input is fetched while this one runs */
+                if (i + 1 < m_threads.size())
+                    m_threads[i + 1]->prefetch();
+                m_threads[i]->start();
+                if (m_threads[i]->Waiting()) {
+                    /* a block can not give up its thread, see CxxThread::suspend() */
+                    CxxLogger::Instance().Log(CxxLogger::Level::Error, "CxxBlockedThread::execute() - Job %lld suspended inside a block, it is left unfinished", (long long)m_threads[i]->IncrementId());
+                    m_threads[i]->reset();
+                }
                 if (m_threads[i]->BreakThreadPool())
                     return 0;
             }
@@ -117,19 +293,169 @@ public:
 
     inline std::vector<CxxThread*>& Threads() { return m_threads; }
 
+    const CxxThread* Current() const override
+    {
+        const CxxThread* current = m_current.load(std::memory_order_acquire);
+        return current ? current->Current() : this;
+    }
+
+private:
+    std::vector<CxxThread*> m_threads;
+    std::atomic<const CxxThread*> m_current { nullptr };
+};
+
+/*! \brief Bump allocator for jobs, memory is released in bulk when the arena is released or destroyed
+ * Jobs created by the arena are not autodelete, so the pool does not delete them; Release() runs their destructors
+ * and frees the chunks. Create() is not thread safe, Release() must only be called once no pool uses the jobs any more */
+class CxxThreadArena {
+public:
+    explicit CxxThreadArena(std::size_t chunk_size = 1 << 20)
+        : m_chunk_size(chunk_size)
+    {
+    }
+    ~CxxThreadArena() { Release(); }
+
+    CxxThreadArena(const CxxThreadArena&) = delete;
+    CxxThreadArena& operator=(const CxxThreadArena&) = delete;
+
+    template <class T, class... Args>
+    T* Create(Args&&... args)
+    {
+        static_assert(std::is_base_of<CxxThread, T>::value, "CxxThreadArena only creates jobs");
+        T* thread = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        thread->setAutoDelete(false);
+        m_threads.push_back(thread);
+        return thread;
+    }
+
+    /*! \brief Destroy all jobs in reverse order of creation and free the chunks */
+    void Release()
+    {
+        for (auto thread = m_threads.rbegin(); thread != m_threads.rend(); ++thread)
+            (*thread)->~CxxThread();
+        m_threads.clear();
+        for (char* chunk : m_chunks)
+            ::operator delete(chunk);
+        m_chunks.clear();
+        m_sizes.clear();
+        m_used = m_capacity = 0;
+    }
+
+    inline std::size_t Size() const { return m_threads.size(); }
+    /*! \brief Bytes reserved in chunks */
+    inline std::size_t Reserved() const
+    {
+        std::size_t reserved = 0;
+        for (std::size_t size : m_sizes)
+            reserved += size;
+        return reserved;
+    }
+
 private:
+    void* Allocate(std::size_t size, std::size_t alignment)
+    {
+        std::size_t offset = (m_used + alignment - 1) / alignment * alignment;
+        if (m_chunks.empty() || offset + size > m_capacity) {
+            /* oversized jobs get a chunk of their own */
+            m_capacity = std::max(m_chunk_size, size + alignment);
+            m_chunks.push_back(static_cast<char*>(::operator new(m_capacity)));
+            m_sizes.push_back(m_capacity);
+            offset = 0;
+        }
+        m_used = offset + size;
+        return m_chunks.back() + offset;
+    }
+
+    std::size_t m_chunk_size;
+    std::size_t m_used = 0, m_capacity = 0;
+    std::vector<char*> m_chunks;
+    std::vector<std::size_t> m_sizes;
     std::vector<CxxThread*> m_threads;
 };
 
 class CxxThreadPool
 {
 public:
+    /*! \brief Queue of jobs, a ring buffer that allocates only when it grows */
+    typedef CxxRing<CxxThread*> JobQueue;
+
     enum class ProgressBarType {
         None = 0,
         Discrete = 1,
         Continously = 2
     };
 
+    /*! \brief Estimated remaining time of the current run in seconds, with a 95 % interval */
+    struct Estimate {
+        double seconds = 0, lower = 0, upper = 0;
+        bool valid = false;
+    };
+
+    /*! \brief Assignment of jobs with known Cost() to the blocks of StaticPool() */
+    enum class Partitioning {
+        Greedy = 0, /* longest job to the least loaded block */
+        KarmarkarKarp = 1 /* largest differencing method */
+    };
+
+    /*! \brief Aggregated runtime of all jobs sharing the same dynamic type
+     * Times are given in milliseconds, the queue wait from the submission of the job to its start; shed, disabled and
+     * never started jobs are left out */
+    struct JobTypeStatistics {
+        std::string name;
+        int count = 0;
+        double total = 0, mean = 0, p99 = 0;
+        double wait_total = 0, wait_mean = 0;
+    };
+
+    /*! \brief Share of the worker time of one tenant in the last run, tenant -1 stands for the jobs without tenant
+     * runtime is the sum of the job runtimes in milliseconds, throughput counts the jobs per second until the last job of the tenant finished */
+    struct TenantStatistics {
+        int tenant = -1;
+        double weight = 1;
+        int jobs = 0;
+        double runtime = 0, share = 0, throughput = 0;
+    };
+
+    /*! \brief OS scheduling of worker threads, applied by each worker thread when it starts ( Linux only ) */
+    struct Scheduling {
+        enum class Policy {
+            Default = 0, /* inherited, usually SCHED_OTHER */
+            Batch = 1, /* SCHED_BATCH */
+            Idle = 2 /* SCHED_IDLE, runs only if nothing else wants the CPU */
+        };
+        enum class IoClass {
+            Default = 0,
+            RealTime = 1,
+            BestEffort = 2,
+            Idle = 3
+        };
+        Policy policy = Policy::Default;
+        int nice = 0; /* 0 keeps the inherited nice value, lowering it requires privileges */
+        IoClass io_class = IoClass::Default;
+        int io_priority = 4; /* 0 ( highest ) to 7 for RealTime and BestEffort */
+
+        inline bool isDefault() const { return policy == Policy::Default && nice == 0 && io_class == IoClass::Default; }
+    };
+
+    /*! \brief Urgent jobs and reserved workers ( see setReservedWorkers ) run in the urgent lane, all others in the batch lane */
+    enum class Lane {
+        Batch = 0,
+        Urgent = 1
+    };
+
+    /*! \brief Throughput of the last eco mode run while the given number of workers ( or thread slots ) was active */
+    struct EcoSample {
+        int workers = 0, jobs = 0;
+        double seconds = 0, throughput = 0;
+    };
+
+    /*! \brief Deadline misses of the last run, lateness ( end - deadline ) is given in milliseconds of the jobs that were run,
+     * negative values mean the job finished early */
+    struct LatenessStatistics {
+        int jobs = 0, missed = 0, shed = 0; /* shed jobs count as missed */
+        double p50 = 0, p90 = 0, p99 = 0, max = 0;
+    };
+
     CxxThreadPool()
     {
         const char* val = std::getenv("CxxThreadBar");
@@ -151,17 +477,12 @@ public:
                 m_evn_overwrite_bar = false;
         }
 
-#ifdef _CxxThreadPool_Verbose
-        std::cout << "CxxThreadPool::CxxThreadPool() - Setting up thread pool for usage" << std::endl;
-        std::cout << "CxxThreadPool::CxxThreadPool() - Wake up every " << m_wake_up << " msecs." << std::endl;
-#endif
+        CxxLogger::Instance().Log(CxxLogger::Level::Info, "CxxThreadPool::CxxThreadPool() - Setting up thread pool for usage, wake up every %lld msecs.", m_wake_up);
 
         /* Set active threads to OMP NUM Threads and set OMP NUM Threads to 1 */
 #if defined(_OPENMP)
 
-#ifdef _CxxThreadPool_Verbose
-        std::cout << "CxxThreadPool::CxxThreadPool() - openMP is enabled, getting OMP_NUM_THREADS" << std::endl;
-#endif
+        CxxLogger::Instance().Log(CxxLogger::Level::Info, "CxxThreadPool::CxxThreadPool() - openMP is enabled, getting OMP_NUM_THREADS");
         val = std::getenv("OMP_NUM_THREADS");
         if (val == nullptr) { // invalid to assign nullptr to std::string
             m_omp_env_thread = 1;
@@ -169,9 +490,7 @@ public:
             m_omp_env_thread = std::max(atoi(std::getenv("OMP_NUM_THREADS")), 1);
         }
 
-#ifdef _CxxThreadPool_Verbose
-        std::cout << "CxxThreadPool::CxxThreadPool() - OMP_NUM_THREADS was " << m_omp_env_thread << std::endl;
-#endif
+        CxxLogger::Instance().Log(CxxLogger::Level::Info, "CxxThreadPool::CxxThreadPool() - OMP_NUM_THREADS was %lld", m_omp_env_thread);
         omp_set_num_threads(1);
 #endif
         setActiveThreadCount(m_omp_env_thread);
@@ -181,21 +500,12 @@ public:
      */
     virtual ~CxxThreadPool()
     {
-       while(m_pool.size())
-       {
-           auto thread = m_pool.front();
-           if (thread->AutoDelete())
-               delete thread;
-           m_pool.pop();
-       }
-
-        for(int i = 0; i < m_active.size(); ++i)
-            if(m_active[i]->AutoDelete())
-                delete m_active[i];
-
-        for(int i = 0; i < m_finished.size(); ++i)
-            if(m_finished[i]->AutoDelete())
-                delete m_finished[i];
+        JoinRunning();
+        std::vector<CxxThread*> jobs = TakeAutoDelete();
+        StopReclaimer();
+        DeleteJobs(jobs, m_teardown == TeardownMode::Serial ? 1 : TeardownThreads());
+        for (auto thread : m_free_threads)
+            delete thread;
 
                 /* Restore old OMP NUM Thread value */
 #if defined(_OPENMP)
@@ -220,11 +530,128 @@ public:
     /*! \brief Set number of active threads */
     inline void setActiveThreadCount(int thread_count) { m_max_thread_count = thread_count; }
 
+    /*! \brief Number of queued jobs that run at the same time at most, without the workers reserved for urgent jobs
+     * Jobs blocking on each other ( for example in CxxPhaser::ArriveAndWait, see CxxPhaser::setConcurrency ) must not be more */
+    inline int Concurrency() const { return std::max(m_max_thread_count - Reserved(), 1); }
+
     /*! \brief Add a thread to the pool */
     inline void addThread(CxxThread *thread)
     {
+        if (m_cost_database)
+            PredictCost(thread);
+        if (thread->Urgent()) {
+            addUrgentThread(thread);
+            return;
+        }
+        thread->setSubmitTime(std::chrono::system_clock::now());
+        if (Schedule(thread))
+            return;
         m_pool.push(thread);
-        m_threads_map.insert(std::pair<int, CxxThread*>(m_pool.size() - 1, thread));
+        if (m_preallocation == 0)
+            m_threads_map.insert(std::pair<int, CxxThread*>(m_pool.size() - 1, thread));
+    }
+
+    /*! \brief Add a short or urgent job, may be called from any thread - also while StartAndWait() is running
+     * Urgent jobs are started before all queued jobs; jobs added after the run has ended wait for the next run */
+    void addUrgentThread(CxxThread* thread)
+    {
+        thread->setUrgent(true);
+        thread->setSubmitTime(std::chrono::system_clock::now());
+        {
+            /* counted first, so that the run cannot end between queueing and counting; under the lock, so that
+             * StartRun() counts the job either as queued or as submitted during the run */
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_urgent_submitted++;
+            m_urgent.push(thread);
+            m_urgent_count++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_progress_mutex);
+            m_progress_cv.notify_one();
+        }
+        m_work_cv.notify_all();
+    }
+
+    /*! \brief Keep count workers ( or thread slots ) free for urgent jobs; they are lent to other jobs only after
+     * no urgent job was waiting for grace milliseconds */
+    inline void setReservedWorkers(int count, int grace = 100)
+    {
+        m_reserved_workers = std::max(count, 0);
+        m_reserve_grace = std::max(grace, 0);
+    }
+    inline int ReservedWorkers() const { return m_reserved_workers; }
+
+    /*! \brief Weight of a tenant ( CxxThread::setTenant ), tenants get worker time in proportion to their weight
+     * Queued tenants and the jobs without tenant ( tenant -1 ) are served by deficit round robin, charged by the measured job runtime */
+    inline void setTenantWeight(int tenant, double weight)
+    {
+        m_tenants[std::max(tenant, -1)].weight = std::max(weight, 1e-3);
+        m_tenants[-1];
+    }
+    double TenantWeight(int tenant) const
+    {
+        auto entry = m_tenants.find(std::max(tenant, -1));
+        return entry == m_tenants.end() ? 1 : entry->second.weight;
+    }
+
+    /*! \brief OS scheduling of all workers, or of the workers of one lane, applied when the worker threads are created */
+    inline void setScheduling(const Scheduling& scheduling) { m_scheduling[0] = m_scheduling[1] = scheduling; }
+    inline void setScheduling(Lane lane, const Scheduling& scheduling) { m_scheduling[int(lane)] = scheduling; }
+    inline const Scheduling& LaneScheduling(Lane lane) const { return m_scheduling[int(lane)]; }
+    /*! \brief Number of worker threads of the last run whose scheduling settings could not ( all ) be applied */
+    inline int SchedulingErrors() const { return m_scheduling_errors.load(); }
+
+    /*! \brief Limit the dispatch of all jobs except urgent ones to rate jobs per second, with bursts of up to burst jobs
+     * A rate of zero removes the limit */
+    inline void setRateLimit(double rate, double burst = 1) { m_rate_limit.setRate(rate, burst); }
+    inline double RateLimit() const { return m_rate_limit.Rate(); }
+
+    /*! \brief Limit the dispatch of the jobs of one class ( CxxThread::setJobClass ), set before the jobs are added
+     * Jobs of limited classes wait in a queue of their own, while the workers run jobs of other classes */
+    inline void setClassRateLimit(int job_class, double rate, double burst = 1) { m_classes[job_class].bucket.setRate(rate, burst); }
+    double ClassRateLimit(int job_class) const
+    {
+        auto entry = m_classes.find(job_class);
+        return entry == m_classes.end() ? 0 : entry->second.bucket.Rate();
+    }
+
+    /*! \brief Drop jobs with a deadline instead of starting them, if they would finish late
+     * The runtime is taken from PredictedCost(), jobs without prediction are only dropped once the deadline has passed */
+    inline void setDeadlineShedding(bool shed) { m_deadline_shedding = shed; }
+    inline bool DeadlineShedding() const { return m_deadline_shedding; }
+
+    /*! \brief A job that has not sent a heartbeat ( CxxThread::heartbeat ) for longer than the stall timeout */
+    struct Stall {
+        int worker = -1; /* persistent worker, -1 for jobs in threads of their own */
+        int job = 0; /* CxxThread::IncrementId() */
+        const CxxThread* thread = nullptr; /* the job itself, owned by the pool */
+        std::string type;
+        double silent = 0; /* milliseconds since the last heartbeat */
+        double runtime = 0; /* milliseconds since the job was started */
+    };
+
+    /*! \brief Check the running jobs for heartbeats while waiting, jobs silent for longer than milliseconds are reported once
+     * per missed heartbeat to the callback ( called from the thread running StartAndWait() ), to Stalls() and to the log.
+     * The jobs are not interrupted. 0 ( default ) disables the monitor */
+    inline void setStallTimeout(int milliseconds, std::function<void(const Stall&)> callback = std::function<void(const Stall&)>())
+    {
+        m_stall_timeout = std::max(milliseconds, 0);
+        m_stall_callback = callback;
+    }
+    inline int StallTimeout() const { return m_stall_timeout; }
+    /*! \brief Stalls reported during the last run */
+    inline const std::vector<Stall>& Stalls() const { return m_stalls; }
+
+    void PrintStallStatistics(std::ostream& stream = std::cout) const
+    {
+        if (m_stalls.empty())
+            return;
+        stream << "Stalled jobs: " << m_stalls.size() << std::endl;
+        stream << std::setw(8) << "worker" << std::setw(8) << "job" << std::setw(14) << "silent [ms]" << std::setw(15) << "runtime [ms]"
+               << "  type" << std::endl;
+        for (const auto& stall : m_stalls)
+            stream << std::setw(8) << stall.worker << std::setw(8) << stall.job << std::setw(14) << stall.silent << std::setw(15) << stall.runtime
+                   << "  " << stall.type << std::endl;
     }
 
     inline void addThreads(const std::vector<CxxThread*>& threads)
@@ -238,7 +665,16 @@ public:
     {
         m_start = std::chrono::system_clock::now();
 
-        if (m_max_thread_count == 1) {
+        /* with known costs the locality groups are run longest-first as a whole */
+        if (!m_reorganised && !(m_cost_database && SortByCost(true)))
+            GroupByLocality();
+        m_performance_cpus.clear();
+        if (m_hybrid_scheduling && !m_persistent_workers)
+            PrepareCritical();
+
+        if (m_persistent_workers) {
+            WorkerLoop();
+        } else if (m_max_thread_count == 1) {
             // SerialLoop();
             ParallelLoop();
         } else {
@@ -246,7 +682,15 @@ public:
         }
         if (m_reorganised) {
             std::vector<CxxThread*> finished;
+            m_partition_actual.clear();
             for (int i = 0; i < m_finished.size(); ++i) {
+                /* urgent jobs, jobs with deadline, tenant jobs and rate limited jobs bypass the blocks */
+                if (m_finished[i]->Urgent() || m_finished[i]->HasDeadline() || m_finished[i]->Tenant() >= 0 || m_finished[i]->JobClass() >= 0) {
+                    finished.push_back(m_finished[i]);
+                    continue;
+                }
+                if (m_partition_predicted.size())
+                    m_partition_actual.push_back(m_finished[i]->TimeMicroseconds() / 1e3);
                 auto vector = static_cast<CxxBlockedThread*>(m_finished[i])->Threads();
                 finished.insert(finished.end(), vector.begin(), vector.end());
                 delete m_finished[i];
@@ -254,11 +698,41 @@ public:
             m_finished = finished;
         }
         m_end = std::chrono::system_clock::now();
+        if (m_cost_database)
+            UpdateCostDatabase();
+        CollectDeadlineStatistics();
+        CollectTenantStatistics();
+        if (m_eco_mode)
+            CollectEcoStatistics();
+        if (m_statistics) {
+            CollectTypeStatistics();
+            PrintTypeStatistics();
+            PrintDeadlineStatistics();
+            PrintTenantStatistics();
+            PrintEcoStatistics();
+            PrintStallStatistics();
+            if (m_partition_actual.size())
+                std::cout << "Static partition imbalance: predicted " << PredictedImbalance() * 100 << " %, actual " << ActualImbalance() * 100 << " %" << std::endl;
+            if (m_persistent_workers) {
+                int steals = 0;
+                for (const auto& worker : m_worker_statistics)
+                    steals += worker.steals;
+                std::cout << "Persistent workers: " << m_worker_statistics.size() << ", shared queue operations per job " << QueueOperationsPerJob() << ", steals " << steals << std::endl;
+                std::cout << "Worker startup: " << m_startup.microseconds << " usecs, per worker " << m_startup.virtual_bytes / 1024 << " kB virtual, " << m_startup.resident_bytes / 1024 << " kB resident" << std::endl;
+                if (m_topology_stealing) {
+                    std::cout << "Steal distance:";
+                    for (int level = CxxTopology::Same; level < CxxTopology::Levels; ++level) {
+                        int count = 0;
+                        for (const auto& worker : m_worker_statistics)
+                            count += worker.steal_distance[level];
+                        std::cout << " " << CxxTopology::Name(level) << " " << count;
+                    }
+                    std::cout << std::endl;
+                }
+            }
+        }
         //std::cout << std::endl;
-#ifdef _CxxThreadPool_Verbose
-        std::cout << std::endl;
-        std::cout << "CxxThreadPool::StartandWait() - Threads finished after " << std::chrono::duration_cast<std::chrono::milliseconds>(m_end - m_start).count() << " mseconds." << std::endl;
-#endif
+        CxxLogger::Instance().Log(CxxLogger::Level::Info, "CxxThreadPool::StartAndWait() - Threads finished after %lld mseconds.", std::chrono::duration_cast<std::chrono::milliseconds>(m_end - m_start).count());
     }
 
     void DynamicPool(int divide = 2)
@@ -268,6 +742,12 @@ public:
         if (m_pool.size() / 2 / m_max_thread_count == 0)
             return;
         m_reorganised = true;
+        m_partition_predicted.clear();
+        if (SortByCost()) {
+            CostBlocks(divide);
+            return;
+        }
+        GroupByLocality();
         std::vector<CxxThread*> threads;
         while (m_pool.size()) {
             int block_size = m_pool.size() / divide;
@@ -295,13 +775,21 @@ public:
         addThreads(threads);
     }
 
-    void StaticPool()
+    /*! \brief Combine the queue into one block per thread
+     * If jobs provide a Cost(), the blocks are balanced by cost instead of by job count */
+    void StaticPool(Partitioning partitioning = Partitioning::Greedy)
     {
         m_reorganised = false;
+        m_partition_predicted.clear();
 
         if (m_pool.size() / 2 / m_max_thread_count == 0)
             return;
         m_reorganised = true;
+        if (PartitionByCost(partitioning))
+            return;
+        GroupByLocality();
+        if (CapacityBlocks())
+            return;
         std::vector<CxxThread*> threads;
         while (m_pool.size()) {
             int block_size = m_pool.size();
@@ -331,184 +819,2241 @@ public:
 
     std::vector<CxxThread*>& Finished() { return m_finished; }
     std::vector<CxxThread*>& Active() { return m_active; }
-    std::queue<CxxThread*>& Queue() { return m_pool; }
+    /*! \brief Copy of the queued jobs, the pool itself keeps them in a ring buffer; use PendingJobs() to change the queue */
+    std::queue<CxxThread*> Queue() const
+    {
+        std::queue<CxxThread*> queue;
+        for (std::size_t i = 0; i < m_pool.size(); ++i)
+            queue.push(m_pool[i]);
+        return queue;
+    }
+    /*! \brief The queue of the pool itself, a ring buffer with the interface of std::queue plus indexed access */
+    JobQueue& PendingJobs() { return m_pool; }
 
-    std::map<int, CxxThread*>& OrderedList() { return m_threads_map; }
+    /*! \brief Jobs queued by addThread() in the order of submission; urgent jobs may be added from any thread and are
+     * therefore not listed. Not available with setPreallocation(), the list would allocate for every job */
+    std::map<int, CxxThread*>& OrderedList()
+    {
+        assert(m_preallocation == 0 && "OrderedList() is not filled with preallocation");
+        return m_threads_map;
+    }
 
     void Reset()
     {
         for (int i = 0; i < m_finished.size(); ++i) {
             m_finished[i]->reset();
-            m_pool.push(m_finished[i]);
+            if (!Schedule(m_finished[i]))
+                m_pool.push(m_finished[i]);
         }
         m_finished.clear();
     }
 
+    /*! \brief How clear() and the destructor delete autodelete jobs owning large buffers */
+    enum class TeardownMode {
+        Serial = 0, /* one after another on the calling thread */
+        Parallel = 1, /* spread over setActiveThreadCount() temporary threads */
+        Background = 2 /* clear() hands them to a reclaimer thread and returns at once, the destructor deletes in parallel */
+    };
+    inline void setTeardown(TeardownMode teardown) { m_teardown = teardown; }
+    inline TeardownMode Teardown() const { return m_teardown; }
+
+    /*! \brief Remove all jobs from the pool and delete the autodelete ones, see setTeardown() */
     void clear()
     {
-        while (m_pool.size()) {
-            auto thread = m_pool.front();
-            if (thread->AutoDelete())
-                delete thread;
-            m_pool.pop();
+        JoinRunning();
+        std::vector<CxxThread*> jobs = TakeAutoDelete();
+        if (m_teardown == TeardownMode::Background)
+            Reclaim(jobs);
+        else
+            DeleteJobs(jobs, m_teardown == TeardownMode::Parallel ? TeardownThreads() : 1);
+    }
+
+    /*! \brief Block until the reclaimer thread deleted all jobs handed to it by clear() */
+    void WaitReclaimed()
+    {
+        std::unique_lock<std::mutex> lock(m_reclaim_mutex);
+        m_reclaimed_cv.wait(lock, [this]() { return m_reclaim.empty() && !m_reclaiming; });
+    }
+
+    /*! \brief Collect per job type statistics after each run and print them as ranked table to cout */
+    inline void setStatistics(bool statistics) { m_statistics = statistics; }
+    inline bool Statistics() const { return m_statistics; }
+
+    /*! \brief Per job type statistics of the last run, ranked by total time */
+    const std::vector<JobTypeStatistics>& TypeStatistics() const { return m_type_statistics; }
+
+    void PrintTypeStatistics(std::ostream& stream = std::cout) const
+    {
+        if (m_type_statistics.empty())
+            return;
+        stream << std::left << std::setw(40) << "Job type" << std::right
+               << std::setw(10) << "count"
+               << std::setw(14) << "total [ms]"
+               << std::setw(12) << "mean [ms]"
+               << std::setw(12) << "p99 [ms]"
+               << std::setw(14) << "wait [ms]" << std::endl;
+        for (const auto& entry : m_type_statistics) {
+            std::string name = entry.name.size() > 39 ? entry.name.substr(0, 36) + "..." : entry.name;
+            stream << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(3)
+                   << std::setw(10) << entry.count
+                   << std::setw(14) << entry.total
+                   << std::setw(12) << entry.mean
+                   << std::setw(12) << entry.p99
+                   << std::setw(14) << entry.wait_mean << std::endl;
         }
+        stream.unsetf(std::ios_base::floatfield);
+    }
 
-        for (int i = 0; i < m_active.size(); ++i)
-            if (m_active[i]->AutoDelete())
-                delete m_active[i];
+    /*! \brief Deadline misses and lateness of the jobs with deadline of the last run */
+    const LatenessStatistics& DeadlineStatistics() const { return m_deadline_statistics; }
 
-        for (int i = 0; i < m_finished.size(); ++i)
-            if (m_finished[i]->AutoDelete())
-                delete m_finished[i];
+    void PrintDeadlineStatistics(std::ostream& stream = std::cout) const
+    {
+        const LatenessStatistics& entry = m_deadline_statistics;
+        if (entry.jobs == 0)
+            return;
+        stream << std::fixed << std::setprecision(3) << "Deadlines: " << entry.jobs << " jobs, " << entry.missed << " missed ( "
+               << entry.shed << " shed ), lateness [ms] p50 " << entry.p50 << ", p90 " << entry.p90 << ", p99 " << entry.p99
+               << ", max " << entry.max << std::endl;
+        stream.unsetf(std::ios_base::floatfield);
+    }
 
-        m_active.clear();
-        m_finished.clear();
+    /*! \brief Worker time and throughput per tenant of the last run, empty if no tenant was used */
+    const std::vector<TenantStatistics>& TenantsStatistics() const { return m_tenant_statistics; }
+
+    void PrintTenantStatistics(std::ostream& stream = std::cout) const
+    {
+        if (m_tenant_statistics.empty())
+            return;
+        stream << std::left << std::setw(10) << "Tenant" << std::right
+               << std::setw(10) << "weight"
+               << std::setw(10) << "jobs"
+               << std::setw(16) << "runtime [ms]"
+               << std::setw(10) << "share"
+               << std::setw(14) << "jobs/s" << std::endl;
+        for (const auto& entry : m_tenant_statistics)
+            stream << std::left << std::setw(10) << (entry.tenant < 0 ? std::string("none") : std::to_string(entry.tenant)) << std::right << std::fixed << std::setprecision(3)
+                   << std::setw(10) << entry.weight
+                   << std::setw(10) << entry.jobs
+                   << std::setw(16) << entry.runtime
+                   << std::setw(9) << entry.share * 100 << "%"
+                   << std::setw(14) << entry.throughput << std::endl;
+        stream.unsetf(std::ios_base::floatfield);
     }
 
-    inline int WakeUp() const { return m_wake_up; }
-    inline void setWakeUp(int wakeup) { m_wake_up = wakeup; }
-    inline void setBarWidth(int width) { m_bar_width = width; }
+    /*! \brief Runtimes of the finished jobs of the last run in milliseconds, in order of submission
+     * Jobs are ordered by SubmitTime(), jobs submitted at the same time by IncrementId(); the order of completion would
+     * bias any replay towards the schedule that was actually run. Shed, disabled and never started jobs are left out */
+    std::vector<double> Durations() const
+    {
+        std::vector<const CxxThread*> jobs;
+        jobs.reserve(m_finished.size());
+        for (const auto* thread : m_finished)
+            if (Ran(thread))
+                jobs.push_back(thread);
+        std::stable_sort(jobs.begin(), jobs.end(), [](const CxxThread* a, const CxxThread* b) {
+            return a->SubmitTime() < b->SubmitTime() || (a->SubmitTime() == b->SubmitTime() && a->IncrementId() < b->IncrementId());
+        });
+        std::vector<double> durations;
+        durations.reserve(jobs.size());
+        for (const auto* thread : jobs)
+            durations.push_back(thread->TimeMicroseconds() / 1e3);
+        return durations;
+    }
 
-private:
-    inline bool StartNext()
+    /*! \brief Write the job runtimes of the last run to file, one value in milliseconds per line in order of submission
+     * The file can be replayed with the CxxScheduleSimulator ( Simulator.h ) */
+    bool WriteDurations(const std::string& filename) const
     {
-        auto thread = m_pool.front();
-        if (thread == NULL)
+        std::ofstream file(filename);
+        if (!file.is_open())
             return false;
-        if (!thread->isEnabled()) {
-            m_finished.push_back(thread);
+        file << std::fixed << std::setprecision(3);
+        for (double duration : Durations())
+            file << duration << "\n";
+        return file.good();
+    }
+
+    /*! \brief Use a persistent cost database ( not owned by the pool )
+     * Jobs with a signature get their predicted cost upon adding, the queue is run longest-first,
+     * DynamicPool() sizes the blocks by predicted cost and the measured runtimes are written back after each run */
+    void setCostDatabase(CxxCostDatabase* database)
+    {
+        m_cost_database = database;
+        if (!m_cost_database)
+            return;
+        for (int i = 0; i < m_pool.size(); ++i) {
+            PredictCost(m_pool.front());
+            m_pool.push(m_pool.front());
             m_pool.pop();
-            return m_pool.size();
         }
-        thread->setIncrementId(m_increment_id);
-        m_increment_id++;
-        std::thread* th = new std::thread(&CxxThread::start, thread);
-        // th->detach();
-        m_running_threads.push_back(std::pair<std::thread*, CxxThread*>(th, thread));
-        m_active.push_back(thread);
-        m_pool.pop();
-        return m_pool.size();
     }
+    inline CxxCostDatabase* CostDatabase() const { return m_cost_database; }
 
-    inline void SerialLoop()
+    /*! \brief Move jobs with equal LocalityKey() next to each other, groups keep the position of their first job
+     * Called by StartAndWait(), StaticPool() and DynamicPool(); returns false if no job has a key */
+    bool GroupByLocality()
     {
+        bool keys = false;
+        for (std::size_t i = 0; i < m_pool.size() && !keys; ++i)
+            keys = m_pool[i]->LocalityKey() >= 0;
+        if (!keys)
+            return false;
+        std::vector<CxxThread*> threads;
+        threads.reserve(m_pool.size());
         while (m_pool.size()) {
-            auto thread = m_pool.front();
-            thread->start();
+            threads.push_back(m_pool.front());
             m_pool.pop();
-            m_finished.push_back(thread);
-            if (thread->BreakThreadPool())
-                break;
         }
+        std::unordered_map<std::int64_t, std::vector<CxxThread*>> groups;
+        for (auto thread : threads)
+            if (thread->LocalityKey() >= 0)
+                groups[thread->LocalityKey()].push_back(thread);
+        for (auto thread : threads) {
+            if (thread->LocalityKey() < 0) {
+                m_pool.push(thread);
+                continue;
+            }
+            auto group = groups.find(thread->LocalityKey());
+            for (auto member : group->second)
+                m_pool.push(member);
+            group->second.clear();
+        }
+        return true;
     }
 
-    inline void ParallelLoop()
+    /*! \brief Order the queue longest predicted cost first, jobs without prediction get the mean cost
+     * With locality, jobs of equal LocalityKey() are kept next to each other and the groups are ordered by their summed
+     * cost, longest-first within each group. Returns false if no costs are known, the queue is unchanged then */
+    bool SortByCost(bool locality = false)
     {
-        m_max = m_pool.size();
-        bool start_next = true;
-        while (((m_pool.size() || m_active.size()) && start_next)) {
-            if (m_pool.size() > 0) {
-                while (m_active.size() < m_max_thread_count) {
-                    if (!StartNext())
-                        break;
-                    Status();
-                }
-            }
-            for (int i = 0; i < m_active.size(); ++i) {
-                if (!m_active[i]->Finished())
-                    continue;
-                else {
-                    for (int j = 0; j < m_running_threads.size(); ++j) {
-                        if (m_running_threads[j].second == m_active[i] && m_running_threads[j].first->joinable()) {
-                            m_running_threads[j].first->join();
-                            delete m_running_threads[j].first;
-                            m_running_threads.erase(m_running_threads.begin() + j);
-                            break;
-                        }
-                    }
-                    m_finished.push_back(m_active[i]);
-                    int time = m_active[i]->Time();
-                    if (time < m_wake_up)
-                        m_wake_up = time;
-                    if (m_active[i]->BreakThreadPool()) {
-                        start_next = false;
-                    }
-                    m_active.erase(m_active.begin() + i);
-                    Status();
-                    continue;
+        std::vector<CxxThread*> threads;
+        while (m_pool.size()) {
+            threads.push_back(m_pool.front());
+            m_pool.pop();
+        }
+        std::vector<double> costs = JobCosts(threads);
+        bool known = !costs.empty() && costs.front() >= 0;
+        if (known) {
+            std::vector<int> order(threads.size());
+            for (int i = 0; i < order.size(); ++i)
+                order[i] = i;
+            /* every job is a group of its own unless it has a key */
+            std::vector<double> group_costs(costs);
+            std::vector<int> groups(order);
+            if (locality) {
+                std::unordered_map<std::int64_t, int> first;
+                for (int i = 0; i < threads.size(); ++i) {
+                    if (threads[i]->LocalityKey() < 0)
+                        continue;
+                    auto group = first.insert(std::make_pair(threads[i]->LocalityKey(), i)).first;
+                    groups[i] = group->second;
+                    if (group->second != i)
+                        group_costs[group->second] += costs[i];
                 }
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(m_wake_up));
+            std::stable_sort(order.begin(), order.end(), [&costs, &group_costs, &groups](int a, int b) {
+                if (groups[a] != groups[b])
+                    return group_costs[groups[a]] > group_costs[groups[b]] || (group_costs[groups[a]] == group_costs[groups[b]] && groups[a] < groups[b]);
+                return costs[a] > costs[b];
+            });
+            for (int index : order)
+                m_pool.push(threads[index]);
+        } else {
+            for (auto thread : threads)
+                m_pool.push(thread);
         }
+        return known;
     }
 
-    inline void Status() const
+    /*! \brief Remaining time of the running StartAndWait(), predicted from the runtimes finished so far
+     * The remaining jobs are assumed to follow the observed runtime distribution and to be spread over
+     * the active threads; the interval combines the spread of the sum with the expected straggler of the last wave */
+    Estimate EstimatedTimeRemaining() const
     {
-#ifdef _CxxThreadPool_Verbose
-        printf(("\n\nCxxThreadPool::Status() - Running %d, Waiting %d, Finished %d\n\n"), m_active.size(), m_pool.size(), m_finished.size());
-#endif
-#ifndef _CxxThreadPool_Verbose
-        Progress();
-#endif
+        Estimate estimate;
+        double remaining = QueuedCount() + 0.5 * ActiveCount();
+        if (m_eta_count == 0 || remaining <= 0) {
+            estimate.valid = m_eta_count > 0;
+            return estimate;
+        }
+        double concurrency = std::max(std::min(double(m_max_thread_count), remaining), 1.0);
+        double sigma = m_eta_count > 1 ? std::sqrt(m_eta_m2 / (m_eta_count - 1)) : 0;
+        double spread = 1.96 * std::sqrt(remaining) * sigma / concurrency;
+        double straggler = sigma * std::sqrt(2 * std::log(concurrency));
+        estimate.seconds = remaining * m_eta_mean / concurrency / 1e3;
+        estimate.lower = std::max(estimate.seconds - spread / 1e3, 0.0);
+        estimate.upper = estimate.seconds + (spread + straggler) / 1e3;
+        estimate.valid = true;
+        return estimate;
     }
 
-    inline void Progress() const
+    /*! \brief Hand out batches of queued jobs to one thread, sized from the measured job runtimes so that
+     * the cost of spawning and joining threads stays below target ( fraction of the batch runtime, 0.01 = 1 % )
+     * Has no effect on runs prepared by StaticPool() or DynamicPool() */
+    inline void setAdaptiveBatching(bool batching, double target = 0.01)
     {
-        switch (m_progresstype) {
-        case ProgressBarType::Discrete:
-            DiscreteProgress();
-            break;
+        m_adaptive_batching = batching;
+        m_batch_target = std::max(target, 1e-6);
+    }
+    inline bool AdaptiveBatching() const { return m_adaptive_batching; }
 
-        case ProgressBarType::Continously:
-            ContinousProgress();
-            break;
+    /*! \brief Run the queue on a fixed set of setActiveThreadCount() worker threads instead of one thread per job
+     * Workers claim small batches from the shared queue into a local buffer; idle workers steal from the buffers of others */
+    inline void setPersistentWorkers(bool persistent) { m_persistent_workers = persistent; }
+    inline bool PersistentWorkers() const { return m_persistent_workers; }
 
-        case ProgressBarType::None:
-        default:
-            break;
-        }
-    }
+    /*! \brief Before a persistent worker runs a job, it calls CxxThread::prefetch() of the job distance places ahead in its
+     * local buffer, so that loading that input overlaps with the jobs running until then. 0 ( default ) disables the calls;
+     * blocks of jobs ( CxxBlockedThread ) always prefetch their next job */
+    inline void setPrefetchDistance(int distance) { m_prefetch_distance = std::max(distance, 0); }
+    inline int PrefetchDistance() const { return m_prefetch_distance; }
 
-    inline void DiscreteProgress() const
+    /*! \brief Stack size in bytes of the threads started by the pool, 0 ( default ) for the system default of usually 8 MB
+     * Without guard page a stack overflow silently corrupts memory, it only saves a page per thread */
+    inline void setStackSize(std::size_t bytes, bool guard = true)
     {
-        int finished = m_finished.size();
-        double p_finished = finished / m_max;
-        if (p_finished < 1e-5 && m_active.size() < m_max_thread_count && m_pool.size() > m_max_thread_count)
-            return;
-        if (p_finished * 10 >= m_small_progress) {
-            int active = m_active.size();
-            int cum_active = finished + m_active.size();
-            double p_active = cum_active / m_max;
-            std::cerr << "[";
-            int bar_finished = m_bar_width * p_finished;
-            int bar_active = m_bar_width * p_active;
-            for (int i = 1; i < m_bar_width; ++i) {
-                if (i <= bar_finished)
-                    std::cerr << "=";
-                else if (i <= bar_active && i > bar_finished)
-                    std::cerr << "-";
-                else if (i >= bar_active && i > bar_finished)
-                    std::cerr << " ";
-            }
-            if (int(p_finished * 100.0) == 0)
-                std::cerr << "]   " << int(p_finished * 100.0) << " % finished jobs" << std::endl;
-            else if (int(p_finished * 100.0) == 100)
-                std::cerr << "] " << int(p_finished * 100.0) << " % finished jobs (" << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - m_last).count() << " secs)" << std::endl;
-            else
-                std::cerr << "]  " << int(p_finished * 100.0) << " % finished jobs (" << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - m_last).count() << " secs)" << std::endl;
-            m_last = std::chrono::system_clock::now();
-            m_small_progress += 1;
-        }
+        m_stack_size = bytes;
+        m_stack_guard = guard;
     }
+    inline std::size_t StackSize() const { return m_stack_size; }
 
-    inline void ContinousProgress() const
+    /*! \brief Threads started by the pool are named prefix-wNN ( persistent workers ), prefix-jNN ( thread of job NN )
+     * and prefix-reclaim, so that profilers tell them apart; an empty prefix ( default ) keeps the name of the starting
+     * thread. Naming costs a system call per thread of the thread per job mode. The kernel keeps 15 characters, so the
+     * prefix should be short, for example cxxpool */
+    inline void setThreadNames(const std::string& prefix) { m_thread_names = prefix; }
+    inline const std::string& ThreadNames() const { return m_thread_names; }
+
+    /*! \brief Cost of starting the persistent workers of the last run, time and growth of the virtual and resident
+     * process size per worker */
+    struct StartupStatistics {
+        int workers = 0;
+        double microseconds = 0, virtual_bytes = 0, resident_bytes = 0;
+    };
+    inline const StartupStatistics& Startup() const { return m_startup; }
+
+    /*! \brief Number of workers each started worker starts in turn, 1 starts them one after another */
+    inline void setStartupFanout(int fanout) { m_startup_fanout = std::max(fanout, 1); }
+    inline int StartupFanout() const { return m_startup_fanout; }
+
+    /*! \brief Reserve the queues and lists of the pool for jobs jobs, so that queueing, dispatching and finishing a job allocate
+     * no memory as long as the pool holds at most that many jobs; 0 ( default ) grows them on demand
+     * The buffers of persistent workers are kept between runs in any case, and OrderedList() is not filled in this mode.
+     * Fused batches ( setAdaptiveBatching ), tenants and the threads of the thread per job mode still allocate */
+    inline void setPreallocation(std::size_t jobs)
     {
-        int finished = m_finished.size();
-        double p_finished = finished / m_max;
-        int active = m_active.size();
-        int cum_active = finished + m_active.size();
-        double p_active = cum_active / m_max;
-        std::cerr << "[";
+        m_preallocation = jobs;
+        Preallocate();
+    }
+    inline std::size_t Preallocation() const { return m_preallocation; }
+
+    /*! \brief Upper limit of jobs a worker claims from the shared queue at once */
+    inline void setMaxBatch(int batch) { m_max_batch = std::max(batch, 1); }
+
+    /*! \brief Pin persistent workers to the online CPUs and let idle workers steal from the topologically closest
+     * worker first ( SMT sibling, shared L2, shared L3, same NUMA node, remote ), read from the sysfs cache topology */
+    inline void setTopologyAwareStealing(bool topology) { m_topology_stealing = topology; }
+    inline bool TopologyAwareStealing() const { return m_topology_stealing; }
+
+    /*! \brief Take P-core/E-core capacities ( sysfs cpu_core, cpu_atom and cpu_capacity ) into account
+     * StaticPool() sizes the blocks by the capacity of the CPU they are pinned to and critical jobs
+     * ( CxxThread::setCritical ) are run first and preferably on P-cores */
+    inline void setHybridScheduling(bool hybrid) { m_hybrid_scheduling = hybrid; }
+    inline bool HybridScheduling() const { return m_hybrid_scheduling; }
+
+    /*! \brief Run the queue on as few workers ( or thread slots ) as needed to finish target jobs per second
+     * The active count starts at one and is adapted from the measured throughput; surplus persistent workers
+     * are parked on a condition variable and workers are pinned so that the active ones share as few cores as possible.
+     * A target of 0 sets no rate: all workers start active and are only parked while too few jobs are queued for them */
+    inline void setEcoMode(bool eco, double target = 0)
+    {
+        m_eco_mode = eco;
+        m_eco_target = std::max(target, 0.0);
+    }
+    inline bool EcoMode() const { return m_eco_mode; }
+    inline double EcoTarget() const { return m_eco_target; }
+
+    /*! \brief Throughput per number of active workers of the last eco mode run, to find the knee of the curve */
+    const std::vector<EcoSample>& EcoStatistics() const { return m_eco_statistics; }
+
+    void PrintEcoStatistics(std::ostream& stream = std::cout) const
+    {
+        if (m_eco_statistics.empty())
+            return;
+        stream << std::right << std::setw(10) << "workers"
+               << std::setw(12) << "time [s]"
+               << std::setw(10) << "jobs"
+               << std::setw(14) << "jobs/s"
+               << std::setw(20) << "jobs/s per worker" << std::endl;
+        for (const auto& entry : m_eco_statistics)
+            stream << std::fixed << std::setprecision(3)
+                   << std::setw(10) << entry.workers
+                   << std::setw(12) << entry.seconds
+                   << std::setw(10) << entry.jobs
+                   << std::setw(14) << entry.throughput
+                   << std::setw(20) << entry.throughput / entry.workers << std::endl;
+        stream.unsetf(std::ios_base::floatfield);
+    }
+
+    /*! \brief Root of the sysfs tree used for the CPU topology, /sys by default */
+    inline void setSysfsRoot(const std::string& root) { m_sysfs_root = root; }
+    inline const std::string& SysfsRoot() const { return m_sysfs_root; }
+
+    /*! \brief Counters of the persistent workers of the last run */
+    struct WorkerStatistics {
+        int jobs = 0; /* jobs executed */
+        int queue_operations = 0; /* accesses of the shared queue, including empty claims and contended locks */
+        int steals = 0, stolen = 0; /* successful steals and jobs taken by them */
+        int cpu = -1; /* pinned CPU with topology aware stealing */
+        std::vector<int> steal_distance = std::vector<int>(CxxTopology::Levels, 0); /* steals per CxxTopology::Level */
+    };
+    const std::vector<WorkerStatistics>& WorkersStatistics() const { return m_worker_statistics; }
+
+    /*! \brief Shared queue accesses per executed job of the last persistent worker run, failed claims and waits for the
+     * lock of the queue included */
+    double QueueOperationsPerJob() const
+    {
+        int jobs = 0, operations = 0;
+        for (const auto& worker : m_worker_statistics) {
+            jobs += worker.jobs;
+            operations += worker.queue_operations;
+        }
+        return jobs ? operations / double(jobs) : 0;
+    }
+
+    /*! \brief Relative excess of the most loaded block of the last cost based StaticPool() over the mean, 0 = perfectly balanced */
+    double PredictedImbalance() const { return Imbalance(m_partition_predicted); }
+    /*! \brief Same as PredictedImbalance(), but from the measured block runtimes of the last run */
+    double ActualImbalance() const { return Imbalance(m_partition_actual); }
+
+    /*! \brief Distribute jobs with the given costs into bins of equal total cost, returns the job indices per bin */
+    static std::vector<std::vector<int>> Partition(const std::vector<double>& costs, int bins, Partitioning partitioning)
+    {
+        std::vector<std::vector<int>> result(std::max(bins, 1));
+        std::vector<int> order(costs.size());
+        for (int i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&costs](int a, int b) { return costs[a] > costs[b]; });
+
+        if (partitioning == Partitioning::Greedy) {
+            typedef std::pair<double, int> Load;
+            std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+            for (int i = 0; i < result.size(); ++i)
+                loads.push(Load(0, i));
+            for (int index : order) {
+                Load load = loads.top();
+                loads.pop();
+                result[load.second].push_back(index);
+                load.first += costs[index];
+                loads.push(load);
+            }
+            return result;
+        }
+
+        /* Largest differencing method: every node is a partial partition of up to bins subsets, sorted by decreasing sum
+         * The two nodes with the largest spread are merged by pairing the largest subsets of one with the smallest of the other
+         * The job lists of the subsets are linked lists in next, so merging subsets is constant in time */
+        struct Subset {
+            double sum;
+            int head, tail;
+        };
+        std::vector<int> next(costs.size(), -1);
+        std::vector<std::vector<Subset>> nodes;
+        typedef std::pair<double, int> Spread;
+        std::priority_queue<Spread> heap;
+        for (int index : order) {
+            Subset subset = { costs[index], index, index };
+            nodes.push_back(std::vector<Subset>(1, subset));
+            heap.push(Spread(bins > 1 ? costs[index] : 0, nodes.size() - 1));
+        }
+        while (heap.size() > 1) {
+            std::vector<Subset> a = nodes[heap.top().second];
+            nodes[heap.top().second].clear();
+            heap.pop();
+            std::vector<Subset> b = nodes[heap.top().second];
+            nodes[heap.top().second].clear();
+            heap.pop();
+
+            std::vector<Subset> merged;
+            for (int i = 0; i < result.size(); ++i) {
+                int j = result.size() - 1 - i;
+                Subset subset = { 0, -1, -1 };
+                if (i < a.size())
+                    subset = a[i];
+                if (j < b.size()) {
+                    if (subset.head == -1)
+                        subset = b[j];
+                    else {
+                        subset.sum += b[j].sum;
+                        next[subset.tail] = b[j].head;
+                        subset.tail = b[j].tail;
+                    }
+                }
+                if (subset.head != -1)
+                    merged.push_back(subset);
+            }
+            std::sort(merged.begin(), merged.end(), [](const Subset& x, const Subset& y) { return x.sum > y.sum; });
+            double spread = merged.front().sum - (merged.size() < result.size() ? 0 : merged.back().sum);
+            nodes.push_back(merged);
+            heap.push(Spread(spread, nodes.size() - 1));
+        }
+        if (heap.size()) {
+            const auto& node = nodes[heap.top().second];
+            for (int i = 0; i < node.size(); ++i)
+                for (int index = node[i].head; index != -1; index = next[index])
+                    result[i].push_back(index);
+        }
+        return result;
+    }
+
+    /*! \brief Greedy partition into bins of different speed, every job goes to the bin finishing it first
+     * ( load + cost ) / capacity; returns the job indices per bin */
+    static std::vector<std::vector<int>> Partition(const std::vector<double>& costs, const std::vector<double>& capacities)
+    {
+        std::vector<std::vector<int>> result(capacities.size());
+        std::vector<double> loads(capacities.size(), 0);
+        std::vector<int> order(costs.size());
+        for (int i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&costs](int a, int b) { return costs[a] > costs[b]; });
+        for (int index : order) {
+            int best = 0;
+            for (int i = 1; i < capacities.size(); ++i)
+                if ((loads[i] + costs[index]) / capacities[i] < (loads[best] + costs[index]) / capacities[best])
+                    best = i;
+            loads[best] += costs[index];
+            result[best].push_back(index);
+        }
+        return result;
+    }
+
+    inline int WakeUp() const { return m_wake_up; }
+    inline void setWakeUp(int wakeup) { m_wake_up = wakeup; }
+    inline void setBarWidth(int width) { m_bar_width = width; }
+
+private:
+    /* The timings are written by the jobs themselves, so everything is gathered
+     * once after the run from m_finished - nothing is touched while jobs are running */
+    /* Shed, disabled and never started jobs have no runtime */
+    static inline bool Ran(const CxxThread* thread) { return thread->isEnabled() && !thread->Shed() && thread->Finished(); }
+
+    void CollectTypeStatistics()
+    {
+        std::unordered_map<std::type_index, std::vector<std::pair<double, double>>> samples;
+        for (const auto* thread : m_finished) {
+            if (!Ran(thread))
+                continue;
+            double wait = std::chrono::duration_cast<std::chrono::microseconds>(thread->StartTime() - thread->SubmitTime()).count() / 1e3;
+            samples[std::type_index(typeid(*thread))].push_back(std::pair<double, double>(thread->TimeMicroseconds() / 1e3, std::max(wait, 0.0)));
+        }
+
+        m_type_statistics.clear();
+        for (auto& type : samples) {
+            auto& times = type.second;
+            JobTypeStatistics entry;
+            entry.name = CxxTrace::TypeName(type.first.name());
+            entry.count = times.size();
+            for (const auto& time : times) {
+                entry.total += time.first;
+                entry.wait_total += time.second;
+            }
+            entry.mean = entry.total / entry.count;
+            entry.wait_mean = entry.wait_total / entry.count;
+            std::sort(times.begin(), times.end());
+            int rank = std::max(int(std::ceil(0.99 * times.size())) - 1, 0);
+            entry.p99 = times[rank].first;
+            m_type_statistics.push_back(entry);
+        }
+        std::sort(m_type_statistics.begin(), m_type_statistics.end(), [](const JobTypeStatistics& a, const JobTypeStatistics& b) {
+            return a.total > b.total;
+        });
+    }
+
+    void CollectDeadlineStatistics()
+    {
+        m_deadline_statistics = LatenessStatistics();
+        std::vector<double> lateness;
+        for (const auto* thread : m_finished) {
+            if (!thread->HasDeadline() || !thread->isEnabled())
+                continue;
+            m_deadline_statistics.jobs++;
+            if (thread->Shed()) {
+                m_deadline_statistics.shed++;
+                m_deadline_statistics.missed++;
+                continue;
+            }
+            lateness.push_back(std::chrono::duration_cast<std::chrono::microseconds>(thread->EndTime() - thread->Deadline()).count() / 1e3);
+            if (lateness.back() > 0)
+                m_deadline_statistics.missed++;
+        }
+        if (lateness.empty())
+            return;
+        std::sort(lateness.begin(), lateness.end());
+        auto percentile = [&lateness](double p) { return lateness[std::max(int(std::ceil(p * lateness.size())) - 1, 0)]; };
+        m_deadline_statistics.p50 = percentile(0.5);
+        m_deadline_statistics.p90 = percentile(0.9);
+        m_deadline_statistics.p99 = percentile(0.99);
+        m_deadline_statistics.max = lateness.back();
+    }
+
+    void CollectTenantStatistics()
+    {
+        m_tenant_statistics.clear();
+        double total = 0;
+        for (const auto& tenant : m_tenants)
+            total += tenant.second.runtime;
+        for (const auto& tenant : m_tenants) {
+            if (tenant.second.jobs == 0)
+                continue;
+            TenantStatistics entry;
+            entry.tenant = tenant.first;
+            entry.weight = tenant.second.weight;
+            entry.jobs = tenant.second.jobs;
+            entry.runtime = tenant.second.runtime;
+            entry.share = total > 0 ? entry.runtime / total : 0;
+            double seconds = std::chrono::duration_cast<std::chrono::microseconds>(tenant.second.last - m_start).count() / 1e6;
+            entry.throughput = seconds > 0 ? entry.jobs / seconds : 0;
+            m_tenant_statistics.push_back(entry);
+        }
+    }
+
+    void PredictCost(CxxThread* thread) const
+    {
+        const std::string signature = thread->Signature();
+        if (signature.empty())
+            return;
+        thread->setCostKey(CxxCostDatabase::Hash(signature));
+        double cost = 0;
+        if (m_cost_database->Lookup(thread->CostKey(), cost))
+            thread->setPredictedCost(cost);
+    }
+
+    /* Cost() of each thread, unknown ones get the mean of the known costs
+     * The first entry is negative if nothing is known at all */
+    std::vector<double> JobCosts(const std::vector<CxxThread*>& threads) const
+    {
+        std::vector<double> costs(threads.size(), -1);
+        double sum = 0;
+        int known = 0;
+        for (int i = 0; i < threads.size(); ++i) {
+            costs[i] = threads[i]->Cost();
+            if (costs[i] >= 0) {
+                sum += costs[i];
+                known++;
+            }
+        }
+        if (known == 0)
+            return costs;
+        for (auto& cost : costs)
+            if (cost < 0)
+                cost = sum / known;
+        return costs;
+    }
+
+    /* Same scheme as DynamicPool, but every round of blocks covers remaining cost / divide instead of remaining jobs / divide */
+    void CostBlocks(int divide)
+    {
+        std::vector<CxxThread*> jobs;
+        while (m_pool.size()) {
+            jobs.push_back(m_pool.front());
+            m_pool.pop();
+        }
+        std::vector<double> costs = JobCosts(jobs);
+        double remaining = 0;
+        for (double cost : costs)
+            remaining += cost;
+
+        std::vector<CxxThread*> threads;
+        int index = 0;
+        while (index < jobs.size()) {
+            double target = remaining / divide / m_max_thread_count;
+            for (int j = 0; j < m_max_thread_count && index < jobs.size(); ++j) {
+                CxxBlockedThread* thread = new CxxBlockedThread;
+                double cost = 0;
+                do {
+                    thread->addThread(jobs[index]);
+                    cost += costs[index];
+                    index++;
+                } while (index < jobs.size() && cost + costs[index] <= target);
+                remaining -= cost;
+                threads.push_back(thread);
+            }
+        }
+        addThreads(threads);
+    }
+
+    static double Imbalance(const std::vector<double>& loads)
+    {
+        if (loads.empty())
+            return 0;
+        double sum = 0, max = 0;
+        for (double load : loads) {
+            sum += load;
+            max = std::max(max, load);
+        }
+        return sum > 0 ? max / (sum / loads.size()) - 1 : 0;
+    }
+
+    bool PartitionByCost(Partitioning partitioning)
+    {
+        std::vector<CxxThread*> jobs;
+        while (m_pool.size()) {
+            jobs.push_back(m_pool.front());
+            m_pool.pop();
+        }
+        std::vector<double> costs = JobCosts(jobs);
+        if (costs.front() < 0) {
+            for (auto job : jobs)
+                m_pool.push(job);
+            return false;
+        }
+
+        std::vector<std::pair<int, double>> cpus = BlockCpus();
+        std::vector<std::vector<int>> bins;
+        if (cpus.size()) {
+            std::vector<double> capacities;
+            for (const auto& cpu : cpus)
+                capacities.push_back(cpu.second);
+            bins = Partition(costs, capacities);
+        } else
+            bins = Partition(costs, m_max_thread_count, partitioning);
+
+        std::vector<CxxThread*> threads;
+        for (int i = 0; i < bins.size(); ++i) {
+            if (bins[i].empty())
+                continue;
+            CxxBlockedThread* thread = new CxxBlockedThread;
+            double cost = 0;
+            for (int index : bins[i]) {
+                thread->addThread(jobs[index]);
+                cost += costs[index];
+            }
+            if (cpus.size()) {
+                thread->setPreferredCpu(cpus[i].first);
+                cost /= cpus[i].second;
+            }
+            m_partition_predicted.push_back(cost);
+            threads.push_back(thread);
+        }
+        addThreads(threads);
+        return true;
+    }
+
+    /* Critical jobs are started first and pinned to the P-cores */
+    void PrepareCritical()
+    {
+        CxxTopology topology;
+        if (topology.Load(m_sysfs_root) && topology.Hybrid()) {
+            std::vector<int> cpus = UsableCpus(topology);
+            for (int cpu : cpus)
+                if (topology.Capacity(cpu) >= 0.99)
+                    m_performance_cpus.push_back(cpu);
+        }
+        std::vector<CxxThread*> critical, normal;
+        while (m_pool.size()) {
+            (m_pool.front()->Critical() ? critical : normal).push_back(m_pool.front());
+            m_pool.pop();
+        }
+        for (auto thread : critical)
+            m_pool.push(thread);
+        for (auto thread : normal)
+            m_pool.push(thread);
+    }
+
+    /* One CPU and its relative capacity per static block, P-cores first; empty unless hybrid scheduling finds cores of different capacity */
+    std::vector<std::pair<int, double>> BlockCpus() const
+    {
+        std::vector<std::pair<int, double>> result;
+        CxxTopology topology;
+        if (!m_hybrid_scheduling || !topology.Load(m_sysfs_root) || !topology.Hybrid())
+            return result;
+        std::vector<int> cpus = UsableCpus(topology);
+        if (cpus.empty())
+            return result;
+        std::stable_sort(cpus.begin(), cpus.end(), [&topology](int a, int b) { return topology.Capacity(a) > topology.Capacity(b); });
+        /* with more blocks than CPUs the blocks sharing a CPU share its capacity */
+        for (int i = 0; i < m_max_thread_count; ++i) {
+            int cpu = i % cpus.size();
+            int sharing = m_max_thread_count / cpus.size() + (cpu < m_max_thread_count % cpus.size() ? 1 : 0);
+            result.push_back(std::make_pair(cpus[cpu], topology.Capacity(cpus[cpu]) / sharing));
+        }
+        return result;
+    }
+
+    /* StaticPool() without costs on hybrid cores: contiguous blocks with job counts proportional to the capacity */
+    bool CapacityBlocks()
+    {
+        std::vector<std::pair<int, double>> cpus = BlockCpus();
+        if (cpus.empty())
+            return false;
+        double capacity = 0;
+        for (const auto& cpu : cpus)
+            capacity += cpu.second;
+        int total = m_pool.size();
+        double assigned = 0;
+        std::vector<CxxThread*> threads;
+        for (int i = 0; i < cpus.size() && m_pool.size(); ++i) {
+            assigned += total * cpus[i].second / capacity;
+            int size = i + 1 == cpus.size() ? m_pool.size() : std::max(int(std::lround(assigned)) - (total - int(m_pool.size())), 0);
+            if (size == 0)
+                continue;
+            CxxBlockedThread* thread = new CxxBlockedThread;
+            for (int j = 0; j < size && m_pool.size(); ++j) {
+                thread->addThread(m_pool.front());
+                m_pool.pop();
+            }
+            thread->setPreferredCpu(cpus[i].first);
+            m_partition_predicted.push_back(thread->Threads().size() / cpus[i].second);
+            threads.push_back(thread);
+        }
+        addThreads(threads);
+        return true;
+    }
+
+    void UpdateCostDatabase()
+    {
+        for (const auto* thread : m_finished)
+            if (thread->isEnabled() && thread->Finished() && thread->CostKey())
+                m_cost_database->Update(thread->CostKey(), thread->TimeMicroseconds() / 1e3);
+    }
+
+    inline bool StartNext()
+    {
+        if (CxxThread* thread = TakeDeadline()) {
+            if (!thread->isEnabled() || thread->Shed())
+                m_finished.push_back(thread);
+            else
+                Launch(thread);
+            return true;
+        }
+        if (CxxThread* thread = TakeLimited()) {
+            if (!thread->isEnabled())
+                m_finished.push_back(thread);
+            else
+                Launch(thread);
+            return true;
+        }
+        if (CxxThread* thread = TakeTenant()) {
+            if (!thread->isEnabled()) {
+                m_finished.push_back(thread);
+                ChargeTenant(thread);
+            } else
+                Launch(thread);
+            return true;
+        }
+        if (m_pool.empty())
+            return false;
+        auto thread = m_pool.front();
+        if (thread == NULL)
+            return false;
+        /* disabled jobs do not run and take no token */
+        if (!thread->isEnabled()) {
+            m_finished.push_back(thread);
+            m_pool.pop();
+            return m_pool.size();
+        }
+        if (m_rate_limit.Limited()) {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            if (m_rate_limit.Take() == 0)
+                return false;
+        }
+        m_pool.pop();
+        thread->setIncrementId(m_increment_id++);
+        if (m_adaptive_batching && !m_reorganised)
+            thread = FuseBatch(thread);
+        Launch(thread);
+        return m_pool.size();
+    }
+
+    inline bool StartUrgent()
+    {
+        CxxThread* thread = TakeUrgent();
+        if (!thread)
+            return false;
+        if (!thread->isEnabled())
+            m_finished.push_back(thread);
+        else
+            Launch(thread);
+        return true;
+    }
+
+    /* Workers of the batch lane leave urgent jobs to the reserved workers if the lanes are scheduled differently, resumed
+     * jobs ( see Resume ) are taken by all workers */
+    inline CxxThread* TakeUrgent(bool urgent_lane = true)
+    {
+        if (m_urgent_count.load(std::memory_order_relaxed) == 0)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        if (m_urgent.empty() || (!urgent_lane && m_urgent.front()->Urgent()))
+            return nullptr;
+        CxxThread* thread = m_urgent.front();
+        thread->setIncrementId(m_increment_id++);
+        m_urgent.pop();
+        m_urgent_count--;
+        if (m_urgent.empty())
+            m_urgent_idle = std::chrono::steady_clock::now().time_since_epoch().count();
+        return thread;
+    }
+
+    /* A job waiting on a channel gives up its worker or thread. Its next run is counted as urgent submission before it is
+     * parked, so that the run can not end while it waits; it is queued as urgent job once it is resumed */
+    void Suspend(CxxThread* thread)
+    {
+        m_urgent_submitted++;
+        m_suspended++;
+        CxxWaitable* waitable = thread->Waiting();
+        {
+            std::lock_guard<std::mutex> lock(m_suspend_mutex);
+            m_parked.push_back(std::make_pair(thread, waitable));
+        }
+        waitable->Park(thread, thread->WaitEvent(), m_resume);
+    }
+
+    /* May be called from any thread, also from within Park(). Runs completely under m_suspend_mutex, so that
+     * DetachSuspended() knows when no resume touches the pool any more; jobs already detached are left alone */
+    void Resume(CxxThread* thread)
+    {
+        std::lock_guard<std::mutex> suspend(m_suspend_mutex);
+        auto parked = std::find_if(m_parked.begin(), m_parked.end(), [thread](const std::pair<CxxThread*, CxxWaitable*>& entry) { return entry.first == thread; });
+        if (parked == m_parked.end())
+            return;
+        *parked = m_parked.back();
+        m_parked.pop_back();
+        thread->reset();
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_urgent.push(thread);
+            m_urgent_count++;
+        }
+        m_suspended--;
+        /* persistent workers pick the job up themselves, without the master */
+        if (m_persistent_workers) {
+            m_work_cv.notify_one();
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_progress_mutex);
+        m_progress_cv.notify_one();
+    }
+
+    /* Remove the jobs still parked after a broken run from their channels, so that no channel resumes them into a
+     * cleared or destroyed pool; resumes already under way are waited for, their jobs end up in the urgent queue */
+    void DetachSuspended(std::vector<CxxThread*>& jobs)
+    {
+        while (true) {
+            std::lock_guard<std::mutex> lock(m_suspend_mutex);
+            for (std::size_t i = 0; i < m_parked.size();) {
+                if (!m_parked[i].second->Cancel(m_parked[i].first)) {
+                    ++i;
+                    continue;
+                }
+                m_parked[i].first->reset();
+                if (m_parked[i].first->AutoDelete())
+                    jobs.push_back(m_parked[i].first);
+                m_parked[i] = m_parked.back();
+                m_parked.pop_back();
+                m_suspended--;
+            }
+            if (m_parked.empty())
+                return;
+            std::this_thread::yield();
+        }
+    }
+
+    /* Jobs with deadline go to the deadline heap, jobs of a tenant to its queue; returns false for all other jobs */
+    inline bool Schedule(CxxThread* thread)
+    {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        auto job_class = m_classes.find(thread->JobClass());
+        if (job_class != m_classes.end() && job_class->second.bucket.Limited()) {
+            job_class->second.queue.push(thread);
+            m_limited_count++;
+            return true;
+        }
+        if (thread->HasDeadline()) {
+            m_deadlines.push_back(thread);
+            std::push_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline);
+            m_deadline_count++;
+            return true;
+        }
+        if (thread->Tenant() < 0)
+            return false;
+        m_tenants[thread->Tenant()].queue.push(thread);
+        m_tenants[-1];
+        m_tenant_count++;
+        return true;
+    }
+
+    /* Deficit round robin over the queued tenants, the common queue takes part as tenant -1
+     * A tenant is served while its deficit is positive; each job is charged its expected runtime when taken and
+     * corrected by the measured runtime when finished ( ChargeTenant ). If no queued tenant has credit left,
+     * all of them are refilled by as many rounds of quantum * weight as the least indebted one needs */
+    inline CxxThread* TakeTenant()
+    {
+        if (m_tenant_count.load(std::memory_order_relaxed) == 0)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        /* the token is taken once the job is known, and only if it is enabled */
+        if (m_tenant_count.load() == 0 || (m_rate_limit.Limited() && m_rate_limit.Wait() != CxxTokenBucket::Clock::duration::zero()))
+            return nullptr;
+        const double quantum = 1; /* milliseconds per round and unit weight */
+        while (true) {
+            auto entry = m_tenants.lower_bound(m_tenant_turn);
+            for (int i = 0; i < m_tenants.size(); ++i, ++entry) {
+                if (entry == m_tenants.end())
+                    entry = m_tenants.begin();
+                Tenant& tenant = entry->second;
+                JobQueue& queue = entry->first < 0 ? m_pool : tenant.queue;
+                if (queue.empty()) {
+                    /* idle tenants do not save up credit */
+                    tenant.deficit = 0;
+                    continue;
+                }
+                if (tenant.deficit <= 0)
+                    continue;
+                CxxThread* thread = queue.front();
+                queue.pop();
+                if (entry->first >= 0)
+                    m_tenant_count--;
+                double expected = thread->PredictedCost() >= 0 ? thread->PredictedCost() : (tenant.jobs ? tenant.runtime / tenant.jobs : quantum);
+                tenant.deficit -= expected;
+                m_tenant_charges[thread] = expected;
+                m_tenant_turn = entry->first;
+                if (tenant.deficit <= 0)
+                    m_tenant_turn = ++entry == m_tenants.end() ? m_tenants.begin()->first : entry->first;
+                if (thread->isEnabled())
+                    m_rate_limit.Take();
+                thread->setIncrementId(m_increment_id++);
+                return thread;
+            }
+            double rounds = -1;
+            for (const auto& entry : m_tenants)
+                if ((entry.first < 0 ? m_pool : entry.second.queue).size()) {
+                    double needed = std::max(std::floor(-entry.second.deficit / (quantum * entry.second.weight)) + 1, 1.0);
+                    rounds = rounds < 0 ? needed : std::min(rounds, needed);
+                }
+            if (rounds < 0)
+                return nullptr;
+            for (auto& entry : m_tenants)
+                if ((entry.first < 0 ? m_pool : entry.second.queue).size())
+                    entry.second.deficit += rounds * quantum * entry.second.weight;
+        }
+    }
+
+    /* First job of a rate limited class that has a token left, the classes are visited round robin */
+    inline CxxThread* TakeLimited()
+    {
+        if (m_limited_count.load(std::memory_order_relaxed) == 0)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        auto now = CxxTokenBucket::Clock::now();
+        if (m_rate_limit.Wait(now) != CxxTokenBucket::Clock::duration::zero())
+            return nullptr;
+        auto entry = m_classes.upper_bound(m_class_turn);
+        for (int i = 0; i < m_classes.size(); ++i, ++entry) {
+            if (entry == m_classes.end())
+                entry = m_classes.begin();
+            JobClass& job_class = entry->second;
+            if (job_class.queue.empty() || (job_class.queue.front()->isEnabled() && job_class.bucket.Take(1, now) == 0))
+                continue;
+            CxxThread* thread = job_class.queue.front();
+            if (thread->isEnabled())
+                m_rate_limit.Take(1, now);
+            job_class.queue.pop();
+            m_limited_count--;
+            m_class_turn = entry->first;
+            thread->setIncrementId(m_increment_id++);
+            return thread;
+        }
+        return nullptr;
+    }
+
+    /* Time until a waiting rate limited job may be dispatched, at most limit */
+    std::chrono::microseconds RateDelay(std::chrono::microseconds limit)
+    {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        auto now = CxxTokenBucket::Clock::now();
+        CxxTokenBucket::Clock::duration delay = limit;
+        if (m_rate_limit.Limited() && (m_pool.size() || ScheduledCount()))
+            delay = std::min(delay, m_rate_limit.Wait(now));
+        for (auto& entry : m_classes)
+            if (entry.second.queue.size())
+                delay = std::min(delay, entry.second.bucket.Wait(now));
+        return std::chrono::duration_cast<std::chrono::microseconds>(delay);
+    }
+
+    inline bool RateLimited() const
+    {
+        if (m_rate_limit.Limited())
+            return true;
+        for (const auto& entry : m_classes)
+            if (entry.second.bucket.Limited())
+                return true;
+        return false;
+    }
+
+    /* Jobs waiting in the deadline heap, the tenant queues and the queues of rate limited classes */
+    inline int ScheduledCount() const { return m_deadline_count.load() + m_tenant_count.load() + m_limited_count.load(); }
+
+    void TakeScheduled(std::vector<CxxThread*>& jobs)
+    {
+        for (auto thread : m_deadlines)
+            if (thread->AutoDelete())
+                jobs.push_back(thread);
+        m_deadlines.clear();
+        m_deadline_count = 0;
+        for (auto& tenant : m_tenants) {
+            while (tenant.second.queue.size()) {
+                if (tenant.second.queue.front()->AutoDelete())
+                    jobs.push_back(tenant.second.queue.front());
+                tenant.second.queue.pop();
+            }
+        }
+        m_tenant_count = 0;
+        for (auto& job_class : m_classes) {
+            while (job_class.second.queue.size()) {
+                if (job_class.second.queue.front()->AutoDelete())
+                    jobs.push_back(job_class.second.queue.front());
+                job_class.second.queue.pop();
+            }
+        }
+        m_limited_count = 0;
+    }
+
+    /* Threads still running after BreakThreadPool() are joined before their jobs are deleted */
+    void JoinRunning()
+    {
+        for (auto& running : m_running_threads) {
+            running.first->join();
+            m_free_threads.push_back(running.first);
+        }
+        m_running_threads.clear();
+    }
+
+    /* Empty all queues and lists, returns the jobs the pool has to delete
+     * Only the pointers are collected here, the reclaimer thread must not touch jobs the caller still owns */
+    std::vector<CxxThread*> TakeAutoDelete()
+    {
+        std::vector<CxxThread*> jobs;
+        jobs.reserve(m_pool.size() + m_active.size() + m_finished.size() + ScheduledCount());
+        DetachSuspended(jobs);
+        while (m_pool.size()) {
+            if (m_pool.front()->AutoDelete())
+                jobs.push_back(m_pool.front());
+            m_pool.pop();
+        }
+        {
+            /* urgent jobs added outside of a run or left by BreakThreadPool(), also resumed ones */
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            while (m_urgent.size()) {
+                if (m_urgent.front()->AutoDelete())
+                    jobs.push_back(m_urgent.front());
+                m_urgent.pop();
+            }
+            m_urgent_count = 0;
+        }
+        TakeScheduled(jobs);
+        for (auto list : { &m_active, &m_finished }) {
+            for (auto thread : *list)
+                if (thread->AutoDelete())
+                    jobs.push_back(thread);
+            list->clear();
+        }
+        return jobs;
+    }
+
+    inline int TeardownThreads() const { return std::max(m_max_thread_count, 1); }
+
+    /* Delete the jobs with up to threads threads, each takes blocks of jobs from a common counter */
+    void DeleteJobs(std::vector<CxxThread*>& jobs, int threads) const
+    {
+        const std::size_t block = 256;
+        threads = std::min<std::size_t>(threads, (jobs.size() + block - 1) / block);
+        std::atomic<std::size_t> next { 0 };
+        auto run = [&jobs, &next, block]() {
+            for (std::size_t begin = next.fetch_add(block); begin < jobs.size(); begin = next.fetch_add(block))
+                for (std::size_t i = begin; i < std::min(begin + block, jobs.size()); ++i)
+                    delete jobs[i];
+        };
+        std::vector<std::unique_ptr<CxxNativeThread>> helpers;
+        for (int i = 1; i < threads; ++i) {
+            helpers.push_back(std::unique_ptr<CxxNativeThread>(new CxxNativeThread));
+            if (!helpers.back()->Start(run, m_stack_size, m_stack_guard))
+                break;
+        }
+        run();
+        for (auto& helper : helpers)
+            if (helper->joinable())
+                helper->join();
+        jobs.clear();
+    }
+
+    /* Hand the jobs to the reclaimer thread, which is started on first use */
+    void Reclaim(std::vector<CxxThread*>& jobs)
+    {
+        if (jobs.empty())
+            return;
+        std::lock_guard<std::mutex> lock(m_reclaim_mutex);
+        if (!m_reclaimer.joinable() && !m_reclaimer.Start([this]() { ReclaimerRun(); }, m_stack_size, m_stack_guard)) {
+            /* no thread available, delete in place */
+            DeleteJobs(jobs, 1);
+            return;
+        }
+        m_reclaim.insert(m_reclaim.end(), jobs.begin(), jobs.end());
+        jobs.clear();
+        m_reclaim_cv.notify_one();
+    }
+
+    void ReclaimerRun()
+    {
+        NameThread("reclaim");
+        std::unique_lock<std::mutex> lock(m_reclaim_mutex);
+        while (true) {
+            m_reclaim_cv.wait(lock, [this]() { return m_reclaim.size() || m_reclaim_stop; });
+            if (m_reclaim.empty())
+                break;
+            std::vector<CxxThread*> jobs;
+            std::swap(jobs, m_reclaim);
+            m_reclaiming = true;
+            lock.unlock();
+            DeleteJobs(jobs, TeardownThreads());
+            lock.lock();
+            m_reclaiming = false;
+            m_reclaimed_cv.notify_all();
+        }
+    }
+
+    /* Finish the pending deletions of the reclaimer thread */
+    void StopReclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_reclaim_mutex);
+            m_reclaim_stop = true;
+            m_reclaim_cv.notify_one();
+        }
+        if (m_reclaimer.joinable())
+            m_reclaimer.join();
+    }
+
+    /* Replace the expected runtime charged in TakeTenant() by the measured one and account the job to its tenant */
+    inline void ChargeTenant(const CxxThread* thread)
+    {
+        double runtime = thread->isEnabled() && !thread->Shed() ? thread->TimeMicroseconds() / 1e3 : 0;
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        auto entry = m_tenants.find(std::max(thread->Tenant(), -1));
+        if (entry == m_tenants.end())
+            return;
+        Tenant& tenant = entry->second;
+        auto charge = m_tenant_charges.find(thread);
+        if (charge != m_tenant_charges.end()) {
+            tenant.deficit += charge->second - runtime;
+            m_tenant_charges.erase(charge);
+        }
+        tenant.jobs++;
+        tenant.runtime += runtime;
+        tenant.last = std::max(tenant.last, thread->EndTime());
+    }
+
+    static bool LaterDeadline(const CxxThread* a, const CxxThread* b) { return a->Deadline() > b->Deadline(); }
+
+    /* Job with the earliest deadline, marked as shed if it can not finish in time any more */
+    inline CxxThread* TakeDeadline()
+    {
+        if (m_deadline_count.load(std::memory_order_relaxed) == 0)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        /* the heap has the earliest deadline in front, disabled jobs take no token */
+        if (m_deadlines.empty() || (m_deadlines.front()->isEnabled() && m_rate_limit.Take() == 0))
+            return nullptr;
+        std::pop_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline);
+        CxxThread* thread = m_deadlines.back();
+        m_deadlines.pop_back();
+        m_deadline_count--;
+        thread->setIncrementId(m_increment_id++);
+        if (m_deadline_shedding) {
+            auto runtime = std::chrono::microseconds(static_cast<long long>(std::max(thread->PredictedCost(), 0.0) * 1e3));
+            thread->setShed(std::chrono::system_clock::now() + runtime > thread->Deadline());
+        }
+        return thread;
+    }
+
+    /* Reserved workers may take other jobs once no urgent job has been waiting for the grace period */
+    inline bool Lend() const
+    {
+        if (m_urgent_count.load(std::memory_order_relaxed))
+            return false;
+        auto idle = std::chrono::steady_clock::duration(m_urgent_idle.load(std::memory_order_relaxed));
+        return std::chrono::steady_clock::now().time_since_epoch() - idle >= std::chrono::milliseconds(m_reserve_grace);
+    }
+
+    /* The job got its IncrementId() when it was taken from its queue, in one place for both modes */
+    inline void Launch(CxxThread* thread)
+    {
+        thread->dispatched();
+        auto begin = std::chrono::steady_clock::now();
+        /* the captures fit into std::function without allocation */
+        std::function<void()> run = [thread]() { thread->start(); };
+        if (!m_scheduling[int(thread->Urgent() ? Lane::Urgent : Lane::Batch)].isDefault() || m_thread_names.size())
+            run = [this, thread]() {
+                NameThread("j", thread->IncrementId());
+                ApplyScheduling(m_scheduling[int(thread->Urgent() ? Lane::Urgent : Lane::Batch)]);
+                thread->start();
+            };
+        CxxNativeThread* th = m_free_threads.size() ? m_free_threads.back() : new CxxNativeThread;
+        if (m_free_threads.size())
+            m_free_threads.pop_back();
+        if (!th->Start(run, m_stack_size, m_stack_guard)) {
+            /* no thread could be created ( out of memory or thread limit ), the job is run in place */
+            m_free_threads.push_back(th);
+            thread->start();
+            m_active.push_back(thread);
+            return;
+        }
+        if (m_adaptive_batching)
+            Smooth(m_spawn_overhead, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count() / 1e3);
+        if (Pinning() && thread->PreferredCpu() >= 0)
+            Pin(*th, thread->PreferredCpu());
+        else if (Pinning() && thread->Critical() && m_performance_cpus.size())
+            Pin(*th, m_performance_cpus);
+        // th->detach();
+        m_running_threads.push_back(std::pair<CxxNativeThread*, CxxThread*>(th, thread));
+        m_active.push_back(thread);
+    }
+
+    /* Exponential smoothing of the measured dispatch costs and job runtimes, in microseconds */
+    static inline void Smooth(double& average, double value)
+    {
+        average = average < 0 ? value : 0.8 * average + 0.2 * value;
+    }
+
+    /* Number of jobs to hand out at once so that spawning and joining stays below the target fraction
+     * of the batch runtime, limited to a share of the remaining queue so that batches shrink while it drains */
+    inline int BatchSize() const
+    {
+        if (m_job_runtime < 0 || m_spawn_overhead < 0)
+            return 1;
+        double overhead = m_spawn_overhead + std::max(m_join_overhead, 0.0);
+        double size = std::ceil(overhead / (m_batch_target * std::max(m_job_runtime, 1e-3)));
+        int limit = std::max(int(m_pool.size() / (2 * m_max_thread_count)), 1);
+        return std::max(std::min(double(limit), size), 1.0);
+    }
+
+    inline CxxThread* FuseBatch(CxxThread* first)
+    {
+        int size = BatchSize();
+        if (size <= 1 || m_pool.empty())
+            return first;
+        /* under a rate limit every further enabled job takes a token, disabled ones are fused without */
+        std::unique_lock<std::mutex> lock(m_queue_mutex, std::defer_lock);
+        if (m_rate_limit.Limited()) {
+            lock.lock();
+            if (m_pool.front()->isEnabled() && m_rate_limit.Take() == 0)
+                return first;
+        }
+        CxxBlockedThread* batch = new CxxBlockedThread;
+        batch->setIncrementId(first->IncrementId());
+        batch->addThread(first);
+        m_pool.front()->setIncrementId(m_increment_id++);
+        batch->addThread(m_pool.front());
+        m_pool.pop();
+        while (batch->Threads().size() < size && m_pool.size()) {
+            if (lock.owns_lock() && m_pool.front()->isEnabled() && m_rate_limit.Take() == 0)
+                break;
+            m_pool.front()->setIncrementId(m_increment_id++);
+            batch->addThread(m_pool.front());
+            m_pool.pop();
+        }
+        m_fused.insert(batch);
+        return batch;
+    }
+
+    /* Jobs of a fused batch are finished individually, those skipped due to BreakThreadPool() go back to the queue */
+    inline bool FinishBatch(CxxBlockedThread* batch)
+    {
+        bool start_next = true;
+        for (auto thread : batch->Threads()) {
+            /* jobs do not choose to be fused, so they may suspend inside the batch as well */
+            if (thread->isEnabled() && thread->Finished() && thread->Waiting()) {
+                Suspend(thread);
+            } else if (!thread->isEnabled() || thread->Finished()) {
+                m_finished.push_back(thread);
+                if (thread->isEnabled())
+                    FinishRuntime(thread->TimeMicroseconds() / 1e3);
+                if (m_tenants.size())
+                    ChargeTenant(thread);
+                if (thread->isEnabled() && thread->BreakThreadPool())
+                    start_next = false;
+            } else
+                m_pool.push(thread);
+        }
+        m_fused.erase(batch);
+        delete batch;
+        return start_next;
+    }
+
+    inline void FinishRuntime(double time)
+    {
+        AddRuntime(time);
+        if (m_adaptive_batching)
+            Smooth(m_job_runtime, time * 1e3);
+    }
+
+    inline void SerialLoop()
+    {
+        while (m_pool.size()) {
+            auto thread = m_pool.front();
+            thread->start();
+            m_pool.pop();
+            m_finished.push_back(thread);
+            if (thread->BreakThreadPool())
+                break;
+        }
+    }
+
+    inline void StartRun()
+    {
+        Preallocate();
+        m_stalls.clear();
+        m_stall_watch.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_urgent_submitted = 0;
+            m_run_jobs = m_pool.size() + m_urgent_count.load() + ScheduledCount();
+        }
+        m_rate_limited = RateLimited();
+        m_scheduling_errors = 0;
+        m_eco_active = m_eco_target > 0 ? 1 : Concurrency();
+        m_eco_samples.assign(std::max(m_max_thread_count, 1) + 1, EcoSample());
+        m_eco_statistics.clear();
+        m_eco_window = std::chrono::steady_clock::now();
+        m_eco_finished = m_persistent_workers ? 0 : m_finished.size();
+        m_tenant_turn = -1;
+        m_tenant_charges.clear();
+        for (auto& tenant : m_tenants) {
+            tenant.second.deficit = tenant.second.runtime = 0;
+            tenant.second.jobs = 0;
+            tenant.second.last = std::chrono::system_clock::now();
+        }
+        m_max = m_run_jobs;
+        m_urgent_idle = std::chrono::steady_clock::now().time_since_epoch().count();
+        m_small_progress = 0;
+        m_last = std::chrono::system_clock::now();
+        m_eta_count = 0;
+        m_eta_mean = m_eta_m2 = 0;
+    }
+
+    inline int Reserved() const { return std::min(m_reserved_workers, m_max_thread_count - 1); }
+
+    /* With the stall monitor the master wakes up at least twice per stall timeout */
+    inline int StallWakeUp(int wake_up) const { return m_stall_timeout ? std::min(wake_up, std::max(m_stall_timeout / 2, 1)) : wake_up; }
+
+    /* Jobs get a heartbeat when they are dispatched, a silent job is reported once per heartbeat value */
+    void CheckStalls()
+    {
+        std::int64_t nanoseconds = CxxThread::SteadyNanoseconds();
+        std::unordered_map<const CxxThread*, std::int64_t> reported;
+        for (const auto& running : m_stall_running) {
+            const CxxThread* job = running.second->Current();
+            auto previous = m_stall_watch.find(job);
+            std::int64_t beat = job->Heartbeat();
+            std::int64_t& last = reported[job] = previous == m_stall_watch.end() ? -1 : previous->second;
+            if ((nanoseconds - beat) / 1e6 > m_stall_timeout && last != beat) {
+                last = beat;
+                Stall stall;
+                stall.worker = running.first;
+                stall.job = job->IncrementId();
+                stall.thread = job;
+                stall.type = CxxTrace::TypeName(typeid(*job).name());
+                stall.silent = (nanoseconds - beat) / 1e6;
+                stall.runtime = std::max((nanoseconds - job->Started()) / 1e6, stall.silent);
+                m_stalls.push_back(stall);
+                CxxLogger::Instance().Log(CxxLogger::Level::Error, "CxxThreadPool::CheckStalls() - Worker %lld, job %lld silent for %lld mseconds", stall.worker, stall.job, (long long)stall.silent);
+                if (m_stall_callback)
+                    m_stall_callback(stall);
+            }
+        }
+        std::swap(reported, m_stall_watch);
+    }
+
+    void Preallocate()
+    {
+        if (m_preallocation == 0)
+            return;
+        m_pool.reserve(m_preallocation);
+        m_urgent.reserve(m_preallocation);
+        m_finished.reserve(m_preallocation);
+        std::size_t threads = std::max(m_max_thread_count, 1);
+        m_active.reserve(threads);
+        m_running_threads.reserve(threads);
+        m_free_threads.reserve(threads);
+        m_worker_statistics.reserve(threads);
+        if (m_worker_buffers.size() < threads)
+            m_worker_buffers.resize(threads);
+        for (auto& buffer : m_worker_buffers) {
+            buffer.finished.reserve(m_preallocation / threads + m_max_batch);
+            buffer.local.reserve(2 * m_max_batch);
+            buffer.stolen.reserve(2 * m_max_batch);
+        }
+    }
+
+    inline void ParallelLoop()
+    {
+        StartRun();
+        bool start_next = true;
+        while (((m_pool.size() || m_active.size() || m_urgent_count.load() || m_suspended.load() || ScheduledCount()) && start_next)) {
+            m_max = m_run_jobs + m_urgent_submitted.load();
+            while (m_active.size() < m_max_thread_count && StartUrgent())
+                Status();
+            if (m_pool.size() > 0 || ScheduledCount()) {
+                int limit = m_max_thread_count - (Reserved() > 0 && !Lend() ? Reserved() : 0);
+                if (m_eco_mode)
+                    limit = std::min(limit, m_eco_active.load());
+                while (m_active.size() < limit) {
+                    if (!StartNext())
+                        break;
+                    Status();
+                }
+            }
+            for (int i = 0; i < m_active.size(); ++i) {
+                if (!m_active[i]->Finished())
+                    continue;
+                else {
+                    for (int j = 0; j < m_running_threads.size(); ++j) {
+                        if (m_running_threads[j].second == m_active[i] && m_running_threads[j].first->joinable()) {
+                            auto begin = std::chrono::steady_clock::now();
+                            m_running_threads[j].first->join();
+                            m_free_threads.push_back(m_running_threads[j].first);
+                            if (m_adaptive_batching)
+                                Smooth(m_join_overhead, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count() / 1e3);
+                            m_running_threads.erase(m_running_threads.begin() + j);
+                            break;
+                        }
+                    }
+                    int time = m_active[i]->Time();
+                    if (time < m_wake_up)
+                        m_wake_up = time;
+                    if (m_active[i]->Waiting()) {
+                        Suspend(m_active[i]);
+                    } else if (m_fused.count(m_active[i])) {
+                        if (!FinishBatch(static_cast<CxxBlockedThread*>(m_active[i])))
+                            start_next = false;
+                    } else {
+                        m_finished.push_back(m_active[i]);
+                        FinishRuntime(m_active[i]->TimeMicroseconds() / 1e3);
+                        if (m_tenants.size())
+                            ChargeTenant(m_active[i]);
+                        if (m_active[i]->BreakThreadPool()) {
+                            start_next = false;
+                        }
+                    }
+                    m_active.erase(m_active.begin() + i);
+                    Status();
+                    continue;
+                }
+            }
+            if (m_eco_mode)
+                EcoControl(m_finished.size());
+            if (m_stall_timeout) {
+                m_stall_running.clear();
+                for (auto thread : m_active)
+                    if (!thread->Finished())
+                        m_stall_running.push_back(std::make_pair(-1, thread));
+                CheckStalls();
+            }
+            /* urgent submissions wake the loop up early if a slot is free, rate limited jobs when their token is due */
+            std::chrono::microseconds timeout = std::chrono::milliseconds(StallWakeUp(m_wake_up));
+            if (m_active.size() < m_max_thread_count && m_rate_limited)
+                timeout = std::max(RateDelay(timeout), std::chrono::microseconds(100));
+            std::unique_lock<std::mutex> lock(m_progress_mutex);
+            m_progress_cv.wait_for(lock, timeout, [this]() {
+                return m_urgent_count.load() > 0 && m_active.size() < m_max_thread_count;
+            });
+        }
+        if (m_eco_mode)
+            EcoControl(m_finished.size(), true);
+    }
+
+    struct Worker {
+        int id = 0;
+        CxxNativeThread thread;
+        std::mutex mutex; /* guards local, finished and the runtime accumulators */
+        JobQueue local;
+        std::vector<CxxThread*> finished;
+        WorkerStatistics statistics;
+        int count = 0;
+        double mean = 0, m2 = 0;
+        std::atomic<int> done { 0 };
+        std::atomic<CxxThread*> current { nullptr }; /* running job, watched by the stall monitor */
+        std::vector<int> victims, distance;
+        std::vector<CxxThread*> stolen; /* scratch buffer of Steal() */
+        bool efficiency = false, reserved = false;
+    };
+
+    inline void WorkerLoop()
+    {
+        StartRun();
+        m_worker_finished = 0;
+        m_worker_running = 0;
+        m_worker_stop = false;
+        m_workers_done = 0;
+        m_worker_statistics.clear();
+
+        if (m_hybrid_scheduling) {
+            JobQueue normal;
+            while (m_pool.size()) {
+                (m_pool.front()->Critical() ? m_critical : normal).push(m_pool.front());
+                m_pool.pop();
+            }
+            std::swap(m_pool, normal);
+        }
+
+        int count = std::max(std::min(m_max_thread_count, int(m_pool.size() + m_critical.size()) + ScheduledCount()), 1);
+        if (m_reserved_workers)
+            count = std::max(m_max_thread_count, 1);
+        m_workers.clear();
+        /* the buffers of the workers are kept between runs, so that a warm pool does not grow them again */
+        if (m_worker_buffers.size() < count)
+            m_worker_buffers.resize(count);
+        for (int i = 0; i < count; ++i) {
+            m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+            m_workers.back()->id = i;
+            m_workers.back()->reserved = i >= count - Reserved();
+            m_workers.back()->finished.swap(m_worker_buffers[i].finished);
+            m_workers.back()->local.swap(m_worker_buffers[i].local);
+            m_workers.back()->stolen.swap(m_worker_buffers[i].stolen);
+        }
+        PlaceWorkers();
+        m_startup = StartupStatistics();
+        m_startup.workers = count;
+        m_startup_virtual = m_startup_resident = 0;
+        MemoryUsage(m_startup_virtual, m_startup_resident);
+        m_workers_started = 0;
+        m_startup_begin = std::chrono::steady_clock::now();
+        StartWorkers(-1);
+
+        /* the progress is sampled every m_wake_up msecs, workers only notify when they are done */
+        int reported = -1;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_progress_mutex);
+                m_progress_cv.wait_for(lock, std::chrono::milliseconds(std::max(StallWakeUp(m_wake_up), 1)), [this]() {
+                    return m_workers_done.load() == int(m_workers.size());
+                });
+            }
+            m_max = m_run_jobs + m_urgent_submitted.load();
+            m_worker_finished = m_worker_running = 0;
+            for (auto& worker : m_workers) {
+                m_worker_finished += worker->done.load(std::memory_order_relaxed);
+                m_worker_running += worker->current.load(std::memory_order_relaxed) != nullptr;
+            }
+            if (m_worker_finished != reported) {
+                reported = m_worker_finished;
+                CollectWorkerRuntimes();
+                Status();
+            }
+            if (m_stall_timeout) {
+                m_stall_running.clear();
+                for (auto& worker : m_workers)
+                    if (CxxThread* thread = worker->current.load(std::memory_order_acquire))
+                        m_stall_running.push_back(std::make_pair(worker->id, thread));
+                CheckStalls();
+            }
+            if (m_eco_mode) {
+                EcoControl(m_worker_finished);
+                /* parked workers have to leave once the run is over */
+                if (m_worker_stop.load() || RunFinished()) {
+                    std::lock_guard<std::mutex> lock(m_park_mutex);
+                    m_park_cv.notify_all();
+                }
+            }
+            if (m_workers_done.load() == int(m_workers.size()))
+                break;
+        }
+        for (auto& worker : m_workers)
+            if (worker->thread.joinable())
+                worker->thread.join();
+        if (m_eco_mode) {
+            int done = 0;
+            for (auto& worker : m_workers)
+                done += worker->done.load();
+            EcoControl(done, true);
+        }
+
+        /* jobs left in local buffers after BreakThreadPool() go back to the queue */
+        JobQueue remaining;
+        for (auto& worker : m_workers) {
+            m_finished.insert(m_finished.end(), worker->finished.begin(), worker->finished.end());
+            for (std::size_t i = 0; i < worker->local.size(); ++i)
+                remaining.push(worker->local[i]);
+            m_worker_statistics.push_back(worker->statistics);
+        }
+        for (std::size_t i = 0; i < m_workers.size(); ++i) {
+            m_workers[i]->finished.clear();
+            m_workers[i]->local.clear();
+            m_worker_buffers[i].finished.swap(m_workers[i]->finished);
+            m_worker_buffers[i].local.swap(m_workers[i]->local);
+            m_worker_buffers[i].stolen.swap(m_workers[i]->stolen);
+        }
+        /* the queue keeps its memory unless jobs have to be put in front of it */
+        if (remaining.size() || m_critical.size()) {
+            for (auto queue : { &m_critical, &m_pool }) {
+                while (queue->size()) {
+                    remaining.push(queue->front());
+                    queue->pop();
+                }
+            }
+            std::swap(m_pool, remaining);
+        }
+        m_workers.clear();
+    }
+
+    /* Victims are visited in order of topological distance, otherwise round robin starting at the next worker */
+    inline void PlaceWorkers()
+    {
+        CxxTopology topology;
+        std::vector<int> cpus;
+        if ((m_topology_stealing || m_hybrid_scheduling || m_eco_mode) && topology.Load(m_sysfs_root))
+            cpus = UsableCpus(topology);
+        if (m_eco_mode)
+            cpus = EcoOrder(topology, cpus);
+        else if (m_hybrid_scheduling)
+            std::stable_sort(cpus.begin(), cpus.end(), [&topology](int a, int b) { return topology.Capacity(a) > topology.Capacity(b); });
+        int count = m_workers.size();
+        for (auto& worker : m_workers) {
+            if (cpus.size()) {
+                worker->statistics.cpu = cpus[worker->id % cpus.size()];
+                worker->efficiency = m_hybrid_scheduling && topology.Capacity(worker->statistics.cpu) < 0.99;
+            }
+            worker->victims.clear();
+            for (int i = 1; i < count; ++i)
+                worker->victims.push_back((worker->id + i) % count);
+        }
+        if (cpus.empty() || !m_topology_stealing)
+            return;
+        for (auto& worker : m_workers) {
+            std::vector<int> distance(count);
+            for (int i = 0; i < count; ++i)
+                distance[i] = topology.Distance(worker->statistics.cpu, m_workers[i]->statistics.cpu);
+            std::stable_sort(worker->victims.begin(), worker->victims.end(), [&distance](int a, int b) { return distance[a] < distance[b]; });
+            worker->distance = distance;
+        }
+    }
+
+    /* Efficient cores first and SMT siblings next to each other, so that the first workers share as few cores as possible */
+    static std::vector<int> EcoOrder(const CxxTopology& topology, std::vector<int> cpus)
+    {
+        std::stable_sort(cpus.begin(), cpus.end(), [&topology](int a, int b) { return topology.Capacity(a) < topology.Capacity(b); });
+        std::vector<int> ordered;
+        std::vector<bool> placed(cpus.size(), false);
+        for (int i = 0; i < cpus.size(); ++i) {
+            if (placed[i])
+                continue;
+            for (int j = i; j < cpus.size(); ++j) {
+                if (!placed[j] && topology.Distance(cpus[i], cpus[j]) <= CxxTopology::SMT) {
+                    ordered.push_back(cpus[j]);
+                    placed[j] = true;
+                }
+            }
+        }
+        return ordered;
+    }
+
+    /* Adapt the number of active workers once per window: one more if the throughput misses the target,
+     * one less if the others would still meet it with 10 % margin. The window covers a few job runtimes per worker,
+     * last only records the final window of the run */
+    inline void EcoControl(int finished, bool last = false)
+    {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(now - m_eco_window).count() / 1e6;
+        int active = m_eco_active.load();
+        double window = std::max(0.1, 4 * m_eta_mean / 1e3 / active);
+        if (seconds < window && !last)
+            return;
+        int jobs = finished - m_eco_finished;
+        double throughput = jobs / seconds;
+        EcoSample& sample = m_eco_samples[active];
+        sample.workers = active;
+        sample.jobs += jobs;
+        sample.seconds += seconds;
+        m_eco_window = now;
+        m_eco_finished = finished;
+        if (last)
+            return;
+        int limit = Concurrency();
+        /* without target, workers are only parked while there are fewer queued jobs than active workers */
+        bool grow = m_eco_target > 0 ? throughput < m_eco_target : QueuedCount() >= active;
+        bool shrink = m_eco_target > 0 ? throughput * (active - 1) / active >= 1.1 * m_eco_target : QueuedCount() < active - 1;
+        if (grow && active < limit && QueuedCount() > 0) {
+            m_eco_active = active + 1;
+            std::lock_guard<std::mutex> lock(m_park_mutex);
+            m_park_cv.notify_all();
+        } else if (active > 1 && shrink)
+            m_eco_active = active - 1;
+    }
+
+    void CollectEcoStatistics()
+    {
+        m_eco_statistics.clear();
+        for (auto& sample : m_eco_samples) {
+            if (sample.seconds <= 0)
+                continue;
+            sample.throughput = sample.jobs / sample.seconds;
+            m_eco_statistics.push_back(sample);
+        }
+    }
+
+    /* Urgent jobs run only on reserved workers if these are scheduled other than the batch lane */
+    inline bool SeparateLanes() const
+    {
+        const Scheduling& urgent = m_scheduling[int(Lane::Urgent)];
+        const Scheduling& batch = m_scheduling[int(Lane::Batch)];
+        return Reserved() > 0 && (urgent.policy != batch.policy || urgent.nice != batch.nice || urgent.io_class != batch.io_class || urgent.io_priority != batch.io_priority);
+    }
+
+    /* Set policy, nice value and I/O priority of the calling thread */
+    inline void ApplyScheduling(const Scheduling& scheduling)
+    {
+        if (scheduling.isDefault())
+            return;
+        bool applied = true;
+#if defined(__linux__)
+        if (scheduling.policy != Scheduling::Policy::Default) {
+            sched_param param;
+            param.sched_priority = 0;
+            applied = sched_setscheduler(0, scheduling.policy == Scheduling::Policy::Batch ? SCHED_BATCH : SCHED_IDLE, &param) == 0 && applied;
+        }
+        /* nice values and I/O priorities are per thread on Linux */
+        pid_t tid = syscall(SYS_gettid);
+        if (scheduling.nice != 0)
+            applied = setpriority(PRIO_PROCESS, tid, scheduling.nice) == 0 && applied;
+        if (scheduling.io_class != Scheduling::IoClass::Default) {
+            const int who_process = 1, class_shift = 13;
+            int priority = (int(scheduling.io_class) << class_shift) | std::max(std::min(scheduling.io_priority, 7), 0);
+            applied = syscall(SYS_ioprio_set, who_process, tid, priority) == 0 && applied;
+        }
+#else
+        applied = false;
+#endif
+        if (!applied)
+            m_scheduling_errors++;
+    }
+
+    /* The affinity mask only applies to the real sysfs, a fake root describes another machine */
+    std::vector<int> UsableCpus(const CxxTopology& topology) const
+    {
+        return Pinning() ? AllowedCpus(topology.Cpus()) : topology.Cpus();
+    }
+
+    /* CPUs of a fake sysfs tree are planned for, but threads are not pinned to them */
+    inline bool Pinning() const { return m_sysfs_root == "/sys"; }
+
+    static std::vector<int> AllowedCpus(const std::vector<int>& cpus)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            std::vector<int> allowed;
+            for (int cpu : cpus)
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &set))
+                    allowed.push_back(cpu);
+            return allowed;
+        }
+#endif
+        return cpus;
+    }
+
+    /* Virtual and resident size of the process in bytes, from /proc/self/statm */
+    static bool MemoryUsage(double& virtual_bytes, double& resident_bytes)
+    {
+#if defined(__linux__)
+        std::ifstream file("/proc/self/statm");
+        double pages = 0, resident = 0;
+        if (!(file >> pages >> resident))
+            return false;
+        double page = sysconf(_SC_PAGESIZE);
+        virtual_bytes = pages * page;
+        resident_bytes = resident * page;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void Pin(CxxNativeThread& thread, int cpu)
+    {
+        if (cpu >= 0)
+            Pin(thread, std::vector<int>(1, cpu));
+    }
+
+    static void Pin(CxxNativeThread& thread, const std::vector<int>& cpus)
+    {
+#if defined(__linux__)
+        Pin(thread.native_handle(), cpus);
+#endif
+    }
+
+#if defined(__linux__)
+    static void Pin(pthread_t thread, const std::vector<int>& cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        if (CPU_COUNT(&set))
+            pthread_setaffinity_np(thread, sizeof(set), &set);
+    }
+#endif
+
+    /* The name is formatted on the stack, naming a thread does not allocate */
+    inline void NameThread(const char* kind, int number = -1) const
+    {
+        if (m_thread_names.empty())
+            return;
+        char name[16];
+        if (number >= 0)
+            std::snprintf(name, sizeof(name), "%s-%s%02d", m_thread_names.c_str(), kind, number);
+        else
+            std::snprintf(name, sizeof(name), "%s-%s", m_thread_names.c_str(), kind);
+        CxxTrace::setThreadName(name);
+    }
+
+    /* Workers are started as a tree: the master starts the first m_startup_fanout workers and worker i
+     * starts workers (i + 1) * m_startup_fanout to (i + 2) * m_startup_fanout - 1 before it runs jobs,
+     * so the pool is up after a logarithmic number of consecutive thread creations */
+    void StartWorkers(int parent)
+    {
+        int first = (parent + 1) * m_startup_fanout;
+        for (int i = first; i < first + m_startup_fanout && i < int(m_workers.size()); ++i) {
+            Worker* worker = m_workers[i].get();
+            if (worker->thread.Start([this, worker]() { WorkerStart(worker); }, m_stack_size, m_stack_guard))
+                continue;
+            /* the remaining workers take over the share of the whole subtree */
+            int skipped = Subtree(i);
+            m_workers_done += skipped;
+            WorkerStarted(skipped);
+        }
+    }
+
+    int Subtree(int root) const
+    {
+        int count = 1;
+        int first = (root + 1) * m_startup_fanout;
+        for (int i = first; i < first + m_startup_fanout && i < int(m_workers.size()); ++i)
+            count += Subtree(i);
+        return count;
+    }
+
+    void WorkerStart(Worker* worker)
+    {
+        NameThread("w", worker->id);
+        StartWorkers(worker->id);
+#if defined(__linux__)
+        if (Pinning() && worker->statistics.cpu >= 0)
+            Pin(pthread_self(), std::vector<int>(1, worker->statistics.cpu));
+#endif
+        WorkerStarted(1);
+        WorkerRun(worker);
+    }
+
+    /* the last worker to come up records the startup time and the memory of all worker threads */
+    void WorkerStarted(int count)
+    {
+        if (m_workers_started.fetch_add(count) + count != int(m_workers.size()))
+            return;
+        m_startup.microseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startup_begin).count() / 1e3;
+        double virtual_after = 0, resident_after = 0;
+        if (MemoryUsage(virtual_after, resident_after)) {
+            m_startup.virtual_bytes = (virtual_after - m_startup_virtual) / m_workers.size();
+            m_startup.resident_bytes = (resident_after - m_startup_resident) / m_workers.size();
+        }
+    }
+
+    inline void WorkerRun(Worker* worker)
+    {
+        ApplyScheduling(m_scheduling[int(worker->reserved ? Lane::Urgent : Lane::Batch)]);
+        while (!m_worker_stop.load(std::memory_order_relaxed)) {
+            if (m_eco_mode && !worker->reserved && worker->id >= m_eco_active.load(std::memory_order_relaxed)) {
+                std::unique_lock<std::mutex> lock(m_park_mutex);
+                m_park_cv.wait(lock, [this, worker]() {
+                    return worker->id < m_eco_active.load() || m_worker_stop.load() || RunFinished();
+                });
+                if (RunFinished())
+                    break;
+                continue;
+            }
+            CxxThread* thread = TakeUrgent(worker->reserved || !SeparateLanes());
+            if (!thread && (!worker->reserved || Lend())) {
+                thread = TakeDeadline();
+                if (!thread)
+                    thread = TakeLimited();
+                if (!thread)
+                    thread = TakeTenant();
+                if (thread)
+                    worker->statistics.queue_operations++;
+            }
+            if (!thread) {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                if (worker->local.size()) {
+                    thread = worker->local.front();
+                    worker->local.pop_front();
+                }
+            }
+            if (!thread && (!worker->reserved || Lend())) {
+                thread = Claim(worker);
+                if (!thread)
+                    thread = Steal(worker);
+            }
+            if (!thread) {
+                if (RunFinished())
+                    break;
+                /* jobs are still running elsewhere and may be stolen or followed by urgent ones */
+                std::chrono::microseconds timeout = std::chrono::milliseconds(1);
+                if (m_rate_limited && (!worker->reserved || Lend()))
+                    timeout = std::max(RateDelay(timeout), std::chrono::microseconds(20));
+                std::unique_lock<std::mutex> lock(m_work_mutex);
+                m_work_cv.wait_for(lock, timeout);
+                continue;
+            }
+            if (m_prefetch_distance)
+                Prefetch(worker);
+            RunJob(worker, thread);
+        }
+        std::lock_guard<std::mutex> lock(m_progress_mutex);
+        m_workers_done++;
+        m_progress_cv.notify_one();
+    }
+
+    /* Under the lock of the worker, so that the job can not be stolen and run while it prefetches */
+    inline void Prefetch(Worker* worker)
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (int(worker->local.size()) >= m_prefetch_distance)
+            worker->local[m_prefetch_distance - 1]->prefetch();
+    }
+
+    inline bool RunFinished() const
+    {
+        int done = 0;
+        for (const auto& worker : m_workers)
+            done += worker->done.load();
+        return done >= m_run_jobs + m_urgent_submitted.load();
+    }
+
+    inline void RunJob(Worker* worker, CxxThread* thread)
+    {
+        bool run = thread->isEnabled() && !thread->Shed();
+        if (run) {
+            thread->dispatched();
+            worker->current.store(thread, std::memory_order_release);
+            thread->start();
+            worker->current.store(nullptr, std::memory_order_relaxed);
+            if (thread->Waiting()) {
+                Suspend(thread);
+                worker->done.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        double time = thread->TimeMicroseconds() / 1e3;
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            if (m_preallocation && worker->finished.size() == worker->finished.capacity()) {
+                /* the shared list is reserved for all jobs, the buffer of the worker only for its share */
+                std::lock_guard<std::mutex> finished(m_finished_mutex);
+                m_finished.insert(m_finished.end(), worker->finished.begin(), worker->finished.end());
+                worker->finished.clear();
+            }
+            worker->finished.push_back(thread);
+            worker->statistics.jobs++;
+            if (run) {
+                worker->count++;
+                double delta = time - worker->mean;
+                worker->mean += delta / worker->count;
+                worker->m2 += delta * (time - worker->mean);
+            }
+        }
+        if (m_tenants.size())
+            ChargeTenant(thread);
+        if (run && thread->BreakThreadPool())
+            m_worker_stop = true;
+        worker->done.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /* Take a batch from the shared queue, the batch shrinks with the remaining queue like guided scheduling */
+    inline CxxThread* Claim(Worker* worker)
+    {
+        /* the batch enters the local buffer before the queue is released, so thieves never miss it; every claim counts,
+         * also an empty or rate limited one, and a contended lock counts twice */
+        std::unique_lock<std::mutex> lock(m_queue_mutex, std::try_to_lock);
+        worker->statistics.queue_operations++;
+        if (!lock.owns_lock()) {
+            worker->statistics.queue_operations++;
+            lock.lock();
+        }
+        /* critical jobs go to P-core workers, E-core workers take them only when nothing else is left */
+        JobQueue& queue = m_critical.size() && (!worker->efficiency || m_pool.empty()) ? m_critical : m_pool;
+        if (queue.empty())
+            return nullptr;
+        int size = worker->reserved ? 1 : std::max(std::min(int(queue.size() / (4 * m_workers.size())), m_max_batch), 1);
+        /* under a rate limit every enabled job of the batch takes a token, disabled ones are passed on without */
+        if (m_rate_limit.Limited() && queue.front()->isEnabled() && m_rate_limit.Take() == 0)
+            return nullptr;
+        CxxThread* thread = queue.front();
+        thread->setIncrementId(m_increment_id++);
+        queue.pop();
+        std::lock_guard<std::mutex> local(worker->mutex);
+        /* a started locality group is completed up to the batch limit */
+        std::int64_t key = thread->LocalityKey();
+        for (int i = 1; queue.size() && (i < size || (key >= 0 && i < m_max_batch && !m_rate_limit.Limited() && queue.front()->LocalityKey() == key)); ++i) {
+            if (m_rate_limit.Limited() && queue.front()->isEnabled() && m_rate_limit.Take() == 0)
+                break;
+            key = queue.front()->LocalityKey();
+            queue.front()->setIncrementId(m_increment_id++);
+            worker->local.push_back(queue.front());
+            queue.pop();
+        }
+        return thread;
+    }
+
+    /* Take half of the local buffer of the first worker that has something left, rounded up to whole locality groups */
+    inline CxxThread* Steal(Worker* worker)
+    {
+        for (int index : worker->victims) {
+            Worker* victim = m_workers[index].get();
+            std::vector<CxxThread*>& stolen = worker->stolen;
+            stolen.clear();
+            {
+                std::lock_guard<std::mutex> lock(victim->mutex);
+                int size = (victim->local.size() + 1) / 2;
+                const auto& local = victim->local;
+                while (size < local.size() && local[local.size() - size]->LocalityKey() >= 0
+                    && local[local.size() - size - 1]->LocalityKey() == local[local.size() - size]->LocalityKey())
+                    size++;
+                for (int j = 0; j < size; ++j) {
+                    stolen.push_back(victim->local.back());
+                    victim->local.pop_back();
+                }
+            }
+            if (stolen.empty())
+                continue;
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->statistics.steals++;
+            worker->statistics.stolen += stolen.size();
+            if (worker->distance.size())
+                worker->statistics.steal_distance[worker->distance[index]]++;
+            for (std::size_t j = stolen.size() - 1; j > 0; --j)
+                worker->local.push_back(stolen[j - 1]);
+            return stolen.back();
+        }
+        return nullptr;
+    }
+
+    /* Combine the runtime accumulators of all workers ( Chan et al. ) for the ETA */
+    inline void CollectWorkerRuntimes()
+    {
+        m_eta_count = 0;
+        m_eta_mean = m_eta_m2 = 0;
+        for (auto& worker : m_workers) {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            if (worker->count == 0)
+                continue;
+            int count = m_eta_count + worker->count;
+            double delta = worker->mean - m_eta_mean;
+            m_eta_mean += delta * worker->count / count;
+            m_eta_m2 += worker->m2 + delta * delta * m_eta_count * worker->count / count;
+            m_eta_count = count;
+        }
+    }
+
+    /* Welford update of mean and variance of the finished runtimes */
+    inline void AddRuntime(double time)
+    {
+        m_eta_count++;
+        double delta = time - m_eta_mean;
+        m_eta_mean += delta / m_eta_count;
+        m_eta_m2 += delta * (time - m_eta_mean);
+    }
+
+    std::string EstimateString() const
+    {
+        Estimate estimate = EstimatedTimeRemaining();
+        if (!estimate.valid || (estimate.seconds == 0 && QueuedCount() + ActiveCount() == 0))
+            return std::string();
+        std::ostringstream stream;
+        stream << std::fixed << std::setprecision(1) << " ETA " << estimate.seconds << " secs [" << estimate.lower << " - " << estimate.upper << "]";
+        return stream.str();
+    }
+
+    inline int FinishedCount() const { return m_persistent_workers ? m_worker_finished : m_finished.size(); }
+    inline int ActiveCount() const { return m_persistent_workers ? m_worker_running : m_active.size(); }
+    inline int QueuedCount() const { return m_persistent_workers ? std::max(int(m_max) - FinishedCount() - ActiveCount(), 0) : m_pool.size() + ScheduledCount(); }
+
+    inline void Status() const
+    {
+        /* the progress bar would be torn apart by the log lines */
+        if (CxxLogger::Instance().Enabled(CxxLogger::Level::Debug))
+            CxxLogger::Instance().Log(CxxLogger::Level::Debug, "CxxThreadPool::Status() - Running %lld, Waiting %lld, Finished %lld", ActiveCount(), QueuedCount(), FinishedCount());
+        else
+            Progress();
+    }
+
+    inline void Progress() const
+    {
+        switch (m_progresstype) {
+        case ProgressBarType::Discrete:
+            DiscreteProgress();
+            break;
+
+        case ProgressBarType::Continously:
+            ContinousProgress();
+            break;
+
+        case ProgressBarType::None:
+        default:
+            break;
+        }
+    }
+
+    inline void DiscreteProgress() const
+    {
+        int finished = FinishedCount();
+        double p_finished = finished / m_max;
+        if (p_finished < 1e-5 && ActiveCount() < m_max_thread_count && QueuedCount() > m_max_thread_count)
+            return;
+        if (p_finished * 10 >= m_small_progress) {
+            int cum_active = finished + ActiveCount();
+            double p_active = cum_active / m_max;
+            std::cerr << "[";
+            int bar_finished = m_bar_width * p_finished;
+            int bar_active = m_bar_width * p_active;
+            for (int i = 1; i < m_bar_width; ++i) {
+                if (i <= bar_finished)
+                    std::cerr << "=";
+                else if (i <= bar_active && i > bar_finished)
+                    std::cerr << "-";
+                else if (i >= bar_active && i > bar_finished)
+                    std::cerr << " ";
+            }
+            if (int(p_finished * 100.0) == 0)
+                std::cerr << "]   " << int(p_finished * 100.0) << " % finished jobs" << std::endl;
+            else if (int(p_finished * 100.0) == 100)
+                std::cerr << "] " << int(p_finished * 100.0) << " % finished jobs (" << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - m_last).count() << " secs)" << std::endl;
+            else
+                std::cerr << "]  " << int(p_finished * 100.0) << " % finished jobs (" << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - m_last).count() << " secs)" << EstimateString() << std::endl;
+            m_last = std::chrono::system_clock::now();
+            m_small_progress += 1;
+        }
+    }
+
+    inline void ContinousProgress() const
+    {
+        int finished = FinishedCount();
+        double p_finished = finished / m_max;
+        int active = ActiveCount();
+        int cum_active = finished + ActiveCount();
+        double p_active = cum_active / m_max;
+        std::cerr << "[";
         int bar_finished = m_bar_width * p_finished;
         int bar_active = m_bar_width * p_active;
         for (int i = 1; i < m_bar_width; ++i) {
@@ -519,7 +3064,7 @@ private:
             else if (i >= bar_active && i > bar_finished)
                 std::cerr << " ";
         }
-        std::cerr << "] " << int(p_finished * 100.0) << " % finished jobs |" << int(active / m_max * 100.0) << " % active jobs |" << int(active / double(m_max_thread_count) * 100.0) << " % load \r";
+        std::cerr << "] " << int(p_finished * 100.0) << " % finished jobs |" << int(active / m_max * 100.0) << " % active jobs |" << int(active / double(m_max_thread_count) * 100.0) << " % load |" << EstimateString() << "    \r";
         std::cerr << std::flush;
     }
 
@@ -531,12 +3076,105 @@ private:
     int m_bar_width = 100;
 
     double m_max = 0;
-    std::queue<CxxThread *>m_pool;
+    JobQueue m_pool;
     std::vector<CxxThread *> m_active, m_finished;
     std::map<int, CxxThread*> m_threads_map;
-    std::vector<std::pair<std::thread*, CxxThread*>> m_running_threads;
-    bool m_reorganised = false, m_evn_overwrite_bar = false;
+    std::vector<std::pair<CxxNativeThread*, CxxThread*>> m_running_threads;
+    std::vector<CxxNativeThread*> m_free_threads; /* joined threads, reused by Launch() */
+    std::size_t m_preallocation = 0;
+    struct WorkerBuffers {
+        std::vector<CxxThread*> finished, stolen;
+        JobQueue local;
+    };
+    std::vector<WorkerBuffers> m_worker_buffers;
+    std::mutex m_finished_mutex; /* guards m_finished while persistent workers run with preallocation */
+    int m_stall_timeout = 0;
+    std::function<void(const Stall&)> m_stall_callback;
+    std::vector<Stall> m_stalls;
+    std::unordered_map<const CxxThread*, std::int64_t> m_stall_watch; /* heartbeat of the last report per running job */
+    std::vector<std::pair<int, CxxThread*>> m_stall_running;
+    bool m_reorganised = false, m_evn_overwrite_bar = false, m_statistics = false;
+    std::vector<JobTypeStatistics> m_type_statistics;
+    CxxCostDatabase* m_cost_database = nullptr;
+    std::vector<double> m_partition_predicted, m_partition_actual;
     std::chrono::time_point<std::chrono::system_clock> m_start, m_end;
     mutable std::chrono::time_point<std::chrono::system_clock> m_last;
     mutable int m_small_progress = 0;
+    bool m_adaptive_batching = false;
+    double m_batch_target = 0.01;
+    double m_spawn_overhead = -1, m_join_overhead = -1, m_job_runtime = -1;
+    std::unordered_set<CxxThread*> m_fused;
+    bool m_persistent_workers = false;
+    int m_prefetch_distance = 0;
+    int m_max_batch = 32;
+    bool m_topology_stealing = false, m_hybrid_scheduling = false;
+    std::string m_sysfs_root = "/sys";
+    std::vector<int> m_performance_cpus;
+    JobQueue m_critical, m_urgent;
+    std::atomic<int> m_urgent_count { 0 }, m_urgent_submitted { 0 };
+    std::atomic<int> m_suspended { 0 }; /* jobs parked on a channel */
+    std::mutex m_suspend_mutex; /* guards m_parked, held by Resume() */
+    std::vector<std::pair<CxxThread*, CxxWaitable*>> m_parked;
+    CxxWaitable::Resume m_resume = [this](CxxThread* thread) { Resume(thread); };
+    std::atomic<long long> m_urgent_idle { 0 };
+    int m_reserved_workers = 0, m_reserve_grace = 100, m_run_jobs = 0;
+    std::vector<CxxThread*> m_deadlines; /* binary heap, earliest deadline first, guarded by m_queue_mutex */
+    std::atomic<int> m_deadline_count { 0 };
+    bool m_deadline_shedding = false;
+    LatenessStatistics m_deadline_statistics;
+    struct Tenant {
+        JobQueue queue; /* the common queue m_pool for tenant -1 */
+        double weight = 1, deficit = 0, runtime = 0;
+        int jobs = 0;
+        std::chrono::time_point<std::chrono::system_clock> last;
+    };
+    std::map<int, Tenant> m_tenants; /* queues and deficits are guarded by m_queue_mutex */
+    std::unordered_map<const CxxThread*, double> m_tenant_charges;
+    std::atomic<int> m_tenant_count { 0 };
+    int m_tenant_turn = -1;
+    std::vector<TenantStatistics> m_tenant_statistics;
+    struct JobClass {
+        CxxTokenBucket bucket;
+        JobQueue queue;
+    };
+    std::map<int, JobClass> m_classes; /* buckets and queues are guarded by m_queue_mutex, like the pool wide bucket */
+    CxxTokenBucket m_rate_limit;
+    std::atomic<int> m_limited_count { 0 };
+    int m_class_turn = -1;
+    bool m_rate_limited = false;
+    bool m_eco_mode = false;
+    double m_eco_target = 0;
+    std::atomic<int> m_eco_active { 1 };
+    std::vector<EcoSample> m_eco_samples, m_eco_statistics;
+    std::chrono::steady_clock::time_point m_eco_window;
+    int m_eco_finished = 0;
+    std::mutex m_park_mutex;
+    Scheduling m_scheduling[2];
+    std::size_t m_stack_size = 0;
+    bool m_stack_guard = true;
+    std::string m_thread_names;
+    StartupStatistics m_startup;
+    TeardownMode m_teardown = TeardownMode::Serial;
+    CxxNativeThread m_reclaimer;
+    std::vector<CxxThread*> m_reclaim;
+    std::mutex m_reclaim_mutex;
+    std::condition_variable m_reclaim_cv, m_reclaimed_cv;
+    bool m_reclaiming = false, m_reclaim_stop = false;
+    int m_startup_fanout = 4;
+    std::chrono::steady_clock::time_point m_startup_begin;
+    double m_startup_virtual = 0, m_startup_resident = 0;
+    std::atomic<int> m_workers_started { 0 };
+    std::atomic<int> m_scheduling_errors { 0 };
+    std::condition_variable m_park_cv;
+    std::mutex m_work_mutex;
+    std::condition_variable m_work_cv;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<WorkerStatistics> m_worker_statistics;
+    std::mutex m_queue_mutex, m_progress_mutex;
+    std::condition_variable m_progress_cv;
+    int m_worker_finished = 0, m_worker_running = 0;
+    std::atomic<int> m_workers_done { 0 };
+    std::atomic<bool> m_worker_stop { false };
+    int m_eta_count = 0;
+    double m_eta_mean = 0, m_eta_m2 = 0;
 };
@@ -0,0 +1,259 @@
+/*
+ * <Asynchronous logger for CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Trace.h"
+
+/*! \brief Process wide asynchronous log, every thread writes fixed size records into a ring buffer of its own
+ * A background thread formats and writes the records in batches, so logging neither takes a lock nor flushes in the
+ * logging thread. Records are dropped ( and counted ) if a ring is full. The level is Off by default, Trace if
+ * _CxxThreadPool_Verbose is defined, and can be set at runtime or with the environment variable CxxThreadLog ( 0 - 4 ) */
+class CxxLogger {
+public:
+    enum class Level {
+        Off = 0,
+        Error = 1,
+        Info = 2,
+        Debug = 3, /* progress of the pool */
+        Trace = 4 /* every job */
+    };
+
+    static CxxLogger& Instance()
+    {
+        static CxxLogger logger;
+        return logger;
+    }
+
+    ~CxxLogger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_drain_mutex);
+            m_stop = true;
+            m_drain_cv.notify_one();
+        }
+        if (m_drain.joinable())
+            m_drain.join();
+        Flush();
+    }
+
+    CxxLogger(const CxxLogger&) = delete;
+    CxxLogger& operator=(const CxxLogger&) = delete;
+
+    inline void setLevel(Level level) { m_level.store(int(level), std::memory_order_relaxed); }
+    inline Level LogLevel() const { return Level(m_level.load(std::memory_order_relaxed)); }
+    inline bool Enabled(Level level) const { return int(level) <= m_level.load(std::memory_order_relaxed); }
+
+    /*! \brief Stream the records are written to, std::cout by default */
+    void setStream(std::ostream* stream)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        m_stream = stream;
+    }
+
+    /*! \brief Time between two batches written by the background thread */
+    inline void setInterval(int milliseconds) { m_interval.store(std::max(milliseconds, 1)); }
+
+    /*! \brief Records per thread that may wait for the background thread, set before the first record is logged */
+    inline void setCapacity(std::size_t records)
+    {
+        std::size_t capacity = 64;
+        while (capacity < records)
+            capacity <<= 1;
+        m_capacity = capacity;
+    }
+
+    /*! \brief Log a record, format is a printf format for up to three long long arguments
+     * Only the pointer is stored, so format has to be a string literal ( or live as long as the logger ) */
+    inline void Log(Level level, const char* format, long long a = 0, long long b = 0, long long c = 0)
+    {
+        if (!Enabled(level))
+            return;
+        Ring* ring = Local();
+        if (!ring)
+            return;
+        std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail - ring->head.load(std::memory_order_acquire) == ring->records.size()) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& record = ring->records[tail & (ring->records.size() - 1)];
+        record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_begin).count();
+        record.format = format;
+        record.level = int(level);
+        record.args[0] = a;
+        record.args[1] = b;
+        record.args[2] = c;
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    /*! \brief Write all pending records now */
+    void Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        m_batch.clear();
+        {
+            std::lock_guard<std::mutex> registry(m_registry_mutex);
+            for (auto& ring : m_rings) {
+                std::size_t head = ring->head.load(std::memory_order_relaxed);
+                std::size_t tail = ring->tail.load(std::memory_order_acquire);
+                for (; head != tail; ++head) {
+                    m_batch.push_back(ring->records[head & (ring->records.size() - 1)]);
+                    m_batch.back().thread = ring->id;
+                }
+                ring->head.store(tail, std::memory_order_release);
+            }
+        }
+        std::stable_sort(m_batch.begin(), m_batch.end(), [](const Record& a, const Record& b) { return a.time < b.time; });
+        m_text.clear();
+        char line[512];
+        static const char* names[] = { "off", "error", "info", "debug", "trace" };
+        for (const auto& record : m_batch) {
+            int length = std::snprintf(line, sizeof(line), "[%12.6f ms] [%s] [t%d] ", record.time / 1e6, names[record.level], record.thread);
+            m_text.append(line, std::min<std::size_t>(std::max(length, 0), sizeof(line) - 1));
+            length = std::snprintf(line, sizeof(line), record.format, record.args[0], record.args[1], record.args[2]);
+            m_text.append(line, std::min<std::size_t>(std::max(length, 0), sizeof(line) - 1));
+            m_text.push_back('\n');
+        }
+        long long dropped = m_dropped.load();
+        if (dropped > m_reported) {
+            std::snprintf(line, sizeof(line), "CxxLogger - %lld records dropped, the rings were full\n", dropped - m_reported);
+            m_text.append(line);
+            m_reported = dropped;
+        }
+        if (m_text.size() && m_stream) {
+            m_stream->write(m_text.data(), m_text.size());
+            m_stream->flush();
+        }
+    }
+
+    /*! \brief Records dropped in total */
+    inline long long Dropped() const { return m_dropped.load(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Record {
+        std::int64_t time = 0;
+        const char* format = nullptr;
+        long long args[3] = { 0, 0, 0 };
+        int level = 0, thread = 0;
+    };
+
+    /* single producer ( the owning thread ), single consumer ( Flush() under the write mutex ) */
+    struct Ring {
+        std::vector<Record> records;
+        std::atomic<std::size_t> head { 0 }, tail { 0 };
+        std::atomic<bool> released { false };
+        int id = 0;
+    };
+
+    /* marks the ring of a thread for reuse once the thread ends */
+    struct Handle {
+        Ring* ring = nullptr;
+        ~Handle()
+        {
+            if (ring)
+                ring->released.store(true, std::memory_order_release);
+        }
+    };
+
+    CxxLogger()
+    {
+#ifdef _CxxThreadPool_Verbose
+        m_level = int(Level::Trace);
+#endif
+        if (const char* level = std::getenv("CxxThreadLog"))
+            m_level = std::max(std::min(std::atoi(level), int(Level::Trace)), 0);
+    }
+
+    Ring* Local()
+    {
+        static thread_local Handle handle;
+        if (!handle.ring)
+            handle.ring = Register();
+        return handle.ring;
+    }
+
+    /* Threads started per job come and go, so the drained rings of finished threads are reused */
+    Ring* Register()
+    {
+        std::lock_guard<std::mutex> lock(m_registry_mutex);
+        for (auto& ring : m_rings) {
+            if (ring->released.load(std::memory_order_acquire) && ring->head.load() == ring->tail.load() && ring->records.size() == m_capacity) {
+                ring->released = false;
+                return ring.get();
+            }
+        }
+        m_rings.push_back(std::unique_ptr<Ring>(new Ring));
+        m_rings.back()->records.resize(m_capacity);
+        m_rings.back()->id = m_rings.size() - 1;
+        if (!m_drain.joinable())
+            m_drain = std::thread([this]() { Drain(); });
+        return m_rings.back().get();
+    }
+
+    void Drain()
+    {
+        CxxTrace::setThreadName("cxxpool-log");
+        std::unique_lock<std::mutex> lock(m_drain_mutex);
+        while (!m_stop) {
+            m_drain_cv.wait_for(lock, std::chrono::milliseconds(m_interval.load()));
+            lock.unlock();
+            Flush();
+            lock.lock();
+        }
+    }
+
+    std::atomic<int> m_level { int(Level::Off) };
+    std::atomic<long long> m_dropped { 0 };
+    long long m_reported = 0;
+    std::size_t m_capacity = 8192;
+    std::atomic<int> m_interval { 10 };
+    Clock::time_point m_begin = Clock::now();
+    std::ostream* m_stream = &std::cout;
+
+    std::mutex m_registry_mutex, m_write_mutex, m_drain_mutex;
+    std::condition_variable m_drain_cv;
+    bool m_stop = false;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    std::vector<Record> m_batch;
+    std::string m_text;
+    std::thread m_drain;
+};
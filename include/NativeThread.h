@@ -0,0 +1,124 @@
+/*
+ * <Thread with configurable stack for CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#define _CxxNativeThread_Posix
+#endif
+
+/*! \brief Joinable thread created through pthread attributes, so that stack size and guard page can be chosen
+ * A stack size of 0 keeps the system default ( usually 8 MB reserved ). Falls back to std::thread without pthreads.
+ * The object must not be destroyed or restarted before the thread was joined */
+class CxxNativeThread {
+public:
+    CxxNativeThread() = default;
+    ~CxxNativeThread()
+    {
+        if (joinable())
+            join();
+    }
+
+    CxxNativeThread(const CxxNativeThread&) = delete;
+    CxxNativeThread& operator=(const CxxNativeThread&) = delete;
+
+    /*! \brief Run function in a new thread, returns false if the thread could not be created */
+    bool Start(std::function<void()> function, std::size_t stack_size = 0, bool guard = true)
+    {
+        if (joinable())
+            return false;
+#ifdef _CxxNativeThread_Posix
+        pthread_attr_t attributes;
+        if (pthread_attr_init(&attributes) != 0)
+            return false;
+        if (stack_size) {
+            std::size_t page = sysconf(_SC_PAGESIZE) > 0 ? sysconf(_SC_PAGESIZE) : 4096;
+            std::size_t size = std::max<std::size_t>(stack_size, PTHREAD_STACK_MIN);
+            pthread_attr_setstacksize(&attributes, (size + page - 1) / page * page);
+        }
+        if (!guard)
+            pthread_attr_setguardsize(&attributes, 0);
+        /* the function is kept in the object, so that small functions are started without allocation */
+        m_function = std::move(function);
+        m_started = pthread_create(&m_thread, &attributes, &CxxNativeThread::Run, this) == 0;
+        pthread_attr_destroy(&attributes);
+        return m_started;
+#else
+        (void)stack_size;
+        (void)guard;
+        m_thread = std::thread(std::move(function));
+        return true;
+#endif
+    }
+
+    inline bool joinable() const
+    {
+#ifdef _CxxNativeThread_Posix
+        return m_started;
+#else
+        return m_thread.joinable();
+#endif
+    }
+
+    void join()
+    {
+#ifdef _CxxNativeThread_Posix
+        if (m_started)
+            pthread_join(m_thread, nullptr);
+        m_started = false;
+#else
+        m_thread.join();
+#endif
+    }
+
+#ifdef _CxxNativeThread_Posix
+    inline pthread_t native_handle() const { return m_thread; }
+#else
+    inline std::thread::native_handle_type native_handle() { return m_thread.native_handle(); }
+#endif
+
+private:
+#ifdef _CxxNativeThread_Posix
+    static void* Run(void* data)
+    {
+        static_cast<CxxNativeThread*>(data)->m_function();
+        return nullptr;
+    }
+
+    std::function<void()> m_function;
+    pthread_t m_thread;
+    bool m_started = false;
+#else
+    std::thread m_thread;
+#endif
+};
@@ -0,0 +1,192 @@
+/*
+ * <Barriers and phasers for CxxThreadPool jobs.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Channel.h"
+
+/*! \brief Reusable barrier with dynamic registration: the registered parties arrive at the end of each phase and the
+ * phase ends once all have arrived. Jobs arrive with Arrive() and suspend on the returned phase until it has ended
+ * ( CxxThread::suspend ), so a phase may have more parties than the pool has workers. Threads block in ArriveAndWait(),
+ * spinning for a while and sleeping after; a barrier is a phaser whose parties do not change */
+class CxxPhaser : public CxxWaitable {
+public:
+    explicit CxxPhaser(int parties = 0)
+        : m_parties(parties)
+    {
+        /* spinning only pays off if the other parties can run meanwhile */
+        if (std::thread::hardware_concurrency() < 2)
+            m_spin = 0;
+    }
+
+    CxxPhaser(const CxxPhaser&) = delete;
+    CxxPhaser& operator=(const CxxPhaser&) = delete;
+
+    /*! \brief Add parties, they take part in the current phase already; returns the current phase */
+    int Register(int count = 1)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_parties += count;
+        return m_phase.load(std::memory_order_relaxed);
+    }
+
+    /*! \brief Arrive at the end of the current phase without waiting, returns the phase arrived at */
+    int Arrive()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        int phase = m_phase.load(std::memory_order_relaxed);
+        if (++m_arrived >= m_parties)
+            Advance(lock);
+        return phase;
+    }
+
+    /*! \brief Arrive and leave, later phases do not wait for the party; returns the phase arrived at */
+    int ArriveAndDeregister()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        int phase = m_phase.load(std::memory_order_relaxed);
+        m_parties--;
+        if (m_arrived >= m_parties)
+            Advance(lock);
+        return phase;
+    }
+
+    /*! \brief True once phase has ended */
+    inline bool Passed(int phase) const { return int(unsigned(m_phase.load(std::memory_order_acquire)) - unsigned(phase)) > 0; }
+
+    /*! \brief Arrive and block until the phase has ended. Returns false without arriving if more parties are registered than
+     * threads run at once ( setConcurrency ), as the blocked parties would then wait for parties that can not start */
+    bool ArriveAndWait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_concurrency > 0 && m_parties > m_concurrency)
+            return false;
+        int phase = m_phase.load(std::memory_order_relaxed);
+        if (++m_arrived >= m_parties) {
+            Advance(lock);
+            return true;
+        }
+        lock.unlock();
+        for (int i = 0; i < m_spin; ++i) {
+            if (Passed(phase))
+                return true;
+            Pause();
+        }
+        lock.lock();
+        m_sleeping++;
+        m_advanced.wait(lock, [this, phase]() { return Passed(phase); });
+        m_sleeping--;
+        return true;
+    }
+
+    inline int Phase() const { return m_phase.load(std::memory_order_acquire); }
+    inline int Parties() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_parties;
+    }
+
+    /*! \brief Number of threads that run at once, for example CxxThreadPool::Concurrency(); 0 ( default ) disables the check */
+    inline void setConcurrency(int threads) { m_concurrency = threads; }
+    inline int Concurrency() const { return m_concurrency; }
+
+    /*! \brief Iterations ArriveAndWait() spins before it sleeps, 0 on machines with a single CPU by default */
+    inline void setSpin(int iterations) { m_spin = iterations; }
+    inline int Spin() const { return m_spin; }
+
+    void Park(CxxThread* thread, int phase, const Resume& resume) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!Passed(phase)) {
+                m_waiters.push_back(Waiter { thread, resume });
+                return;
+            }
+        }
+        resume(thread);
+    }
+
+    bool Cancel(CxxThread* thread) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto waiter = m_waiters.begin(); waiter != m_waiters.end(); ++waiter) {
+            if (waiter->thread != thread)
+                continue;
+            m_waiters.erase(waiter);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Waiter {
+        CxxThread* thread;
+        Resume resume;
+    };
+
+    static inline void Pause()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    /* Ends the phase, the sleeping threads are notified and the suspended jobs resumed after the lock is released.
+     * The next phase may end before the jobs are resumed, so every call resumes its own list; a spare buffer is kept,
+     * so that the phases do not allocate */
+    void Advance(std::unique_lock<std::mutex>& lock)
+    {
+        m_arrived = 0;
+        m_phase.fetch_add(1, std::memory_order_release);
+        bool sleeping = m_sleeping > 0;
+        std::vector<Waiter> resuming;
+        resuming.swap(m_spare);
+        resuming.swap(m_waiters);
+        lock.unlock();
+        if (sleeping)
+            m_advanced.notify_all();
+        for (auto& waiter : resuming)
+            waiter.resume(waiter.thread);
+        lock.lock();
+        resuming.clear();
+        if (resuming.capacity() > m_spare.capacity())
+            m_spare.swap(resuming);
+    }
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_advanced;
+    std::atomic<int> m_phase { 0 };
+    int m_parties, m_arrived = 0, m_sleeping = 0;
+    int m_concurrency = 0, m_spin = 4000;
+    std::vector<Waiter> m_waiters, m_spare;
+};
@@ -0,0 +1,87 @@
+/*
+ * <Cache and page prefetch helpers for CxxThreadPool jobs.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*! \brief Hints to warm the input of a job before it runs, for use in CxxThread::prefetch()
+ * Software prefetches are only hints, they neither fault nor block, so stale or invalid addresses do no harm */
+class CxxPrefetch {
+public:
+    static const std::size_t Line = 64;
+
+    /*! \brief Fetch the cache line holding address for reading */
+    static inline void Read(const void* address)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(address, 0, 3);
+#else
+        (void)address;
+#endif
+    }
+
+    /*! \brief Fetch the cache line holding address for writing */
+    static inline void Write(const void* address)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(address, 1, 3);
+#else
+        (void)address;
+#endif
+    }
+
+    /*! \brief Fetch bytes starting at address line by line, at most limit bytes ( the L1 cache holds some hundred lines ) */
+    static inline void Range(const void* address, std::size_t bytes, std::size_t limit = 16384)
+    {
+        const char* begin = static_cast<const char*>(address);
+        const char* end = begin + std::min(bytes, limit);
+        for (const char* line = begin; line < end; line += Line)
+            Read(line);
+    }
+
+    /*! \brief Ask the kernel to read in the pages of a memory mapped range ahead ( madvise WILLNEED ), returns false on error
+     * Useful for mapped files that may not be in the page cache yet, the call itself does not wait for the reads */
+    static bool WillNeed(const void* address, std::size_t bytes)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        long page = sysconf(_SC_PAGESIZE) > 0 ? sysconf(_SC_PAGESIZE) : 4096;
+        std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(address) / page * page;
+        std::uintptr_t end = reinterpret_cast<std::uintptr_t>(address) + bytes;
+        return madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED) == 0;
+#else
+        (void)address;
+        (void)bytes;
+        return false;
+#endif
+    }
+};
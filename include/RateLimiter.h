@@ -0,0 +1,89 @@
+/*
+ * <Token bucket rate limiter for CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/*! \brief Token bucket, rate tokens per second are added up to burst tokens
+ * A rate of zero or less means no limit. Not thread safe, the pool guards it with its queue mutex */
+class CxxTokenBucket {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    CxxTokenBucket() = default;
+    CxxTokenBucket(double rate, double burst)
+    {
+        setRate(rate, burst);
+    }
+
+    /*! \brief Set the rate in tokens per second and the bucket size, the bucket starts full */
+    void setRate(double rate, double burst = 1)
+    {
+        m_rate = rate;
+        m_burst = std::max(burst, 1.0);
+        m_tokens = m_burst;
+        m_last = Clock::now();
+    }
+
+    inline double Rate() const { return m_rate; }
+    inline double Burst() const { return m_burst; }
+    inline bool Limited() const { return m_rate > 0; }
+
+    /*! \brief Take up to count tokens, returns the number of tokens taken */
+    int Take(int count = 1, Clock::time_point now = Clock::now())
+    {
+        if (!Limited())
+            return count;
+        Refill(now);
+        int taken = std::min(count, int(std::floor(m_tokens)));
+        m_tokens -= taken;
+        return taken;
+    }
+
+    /*! \brief Time until the next token is available, zero if one is available now */
+    Clock::duration Wait(Clock::time_point now = Clock::now())
+    {
+        if (!Limited())
+            return Clock::duration::zero();
+        Refill(now);
+        if (m_tokens >= 1)
+            return Clock::duration::zero();
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1 - m_tokens) / m_rate));
+    }
+
+private:
+    void Refill(Clock::time_point now)
+    {
+        if (now <= m_last)
+            return;
+        m_tokens = std::min(m_burst, m_tokens + std::chrono::duration<double>(now - m_last).count() * m_rate);
+        m_last = now;
+    }
+
+    double m_rate = 0, m_burst = 1, m_tokens = 1;
+    Clock::time_point m_last = Clock::now();
+};
@@ -0,0 +1,104 @@
+/*
+ * <Growable ring buffer queue for CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/*! \brief Queue in a ring buffer, memory is only allocated when the ring has to grow
+ * Offers the std::queue interface used by the pool plus access to both ends and by index ( from the front ) */
+template <class T>
+class CxxRing {
+public:
+    CxxRing() = default;
+
+    inline void push(const T& value)
+    {
+        if (m_size == m_data.size())
+            Grow(m_size ? 2 * m_size : 16);
+        m_data[(m_head + m_size) & (m_data.size() - 1)] = value;
+        m_size++;
+    }
+    inline void push_back(const T& value) { push(value); }
+
+    inline void pop()
+    {
+        m_head = (m_head + 1) & (m_data.size() - 1);
+        m_size--;
+    }
+    inline void pop_front() { pop(); }
+    inline void pop_back() { m_size--; }
+
+    inline T& front() { return m_data[m_head]; }
+    inline const T& front() const { return m_data[m_head]; }
+    inline T& back() { return (*this)[m_size - 1]; }
+    inline const T& back() const { return (*this)[m_size - 1]; }
+    inline T& operator[](std::size_t index) { return m_data[(m_head + index) & (m_data.size() - 1)]; }
+    inline const T& operator[](std::size_t index) const { return m_data[(m_head + index) & (m_data.size() - 1)]; }
+
+    inline std::size_t size() const { return m_size; }
+    inline bool empty() const { return m_size == 0; }
+    inline std::size_t capacity() const { return m_data.size(); }
+
+    /*! \brief Remove all elements, the memory is kept */
+    inline void clear() { m_head = m_size = 0; }
+
+    /*! \brief Make room for at least capacity elements, rounded up to a power of two */
+    void reserve(std::size_t capacity)
+    {
+        if (capacity > m_data.size())
+            Grow(capacity);
+    }
+
+    void swap(CxxRing& other)
+    {
+        m_data.swap(other.m_data);
+        std::swap(m_head, other.m_head);
+        std::swap(m_size, other.m_size);
+    }
+
+private:
+    void Grow(std::size_t capacity)
+    {
+        std::size_t size = 16;
+        while (size < capacity)
+            size <<= 1;
+        std::vector<T> data(size);
+        for (std::size_t i = 0; i < m_size; ++i)
+            data[i] = (*this)[i];
+        m_data.swap(data);
+        m_head = 0;
+    }
+
+    std::vector<T> m_data;
+    std::size_t m_head = 0, m_size = 0;
+};
+
+template <class T>
+inline void swap(CxxRing<T>& a, CxxRing<T>& b)
+{
+    a.swap(b);
+}
@@ -0,0 +1,280 @@
+/*
+ * <Offline replay of recorded job runtimes for CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*! \brief Replays recorded job runtimes ( see CxxThreadPool::WriteDurations ) in virtual time
+ * and predicts makespan and utilisation for different scheduling strategies and thread counts.
+ * All times are given in milliseconds of compute. */
+class CxxScheduleSimulator {
+public:
+    enum class Strategy {
+        FIFO = 0, /* single pool, jobs in submission order */
+        LPT = 1, /* single pool, longest job first */
+        Static = 2, /* StaticPool() */
+        Dynamic = 3, /* DynamicPool(parameter) */
+        Guided = 4, /* chunks of remaining / threads, taken on demand */
+        WorkStealing = 5 /* equal blocks per thread, idle threads steal half of the largest block */
+    };
+
+    struct Result {
+        Strategy strategy = Strategy::FIFO;
+        int threads = 1;
+        int parameter = 0;
+        double makespan = 0;
+        double utilization = 0;
+    };
+
+    CxxScheduleSimulator() = default;
+
+    bool LoadDurations(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        if (!file.is_open())
+            return false;
+        m_durations.clear();
+        double duration = 0;
+        while (file >> duration)
+            m_durations.push_back(duration);
+        return true;
+    }
+
+    inline void setDurations(const std::vector<double>& durations) { m_durations = durations; }
+    inline const std::vector<double>& Durations() const { return m_durations; }
+
+    /*! \brief Cost of handing one job or one block of jobs to a thread, in milliseconds */
+    inline void setDispatchOverhead(double overhead) { m_overhead = overhead; }
+
+    /*! \brief Simulate one strategy, parameter is the divider for Dynamic and ignored otherwise */
+    Result Simulate(Strategy strategy, int threads, int parameter = 2) const
+    {
+        Result result;
+        result.strategy = strategy;
+        result.threads = std::max(threads, 1);
+        result.parameter = strategy == Strategy::Dynamic ? parameter : 0;
+        if (m_durations.empty())
+            return result;
+
+        switch (strategy) {
+        case Strategy::LPT: {
+            std::vector<double> sorted = m_durations;
+            std::sort(sorted.begin(), sorted.end(), std::greater<double>());
+            result.makespan = ListSchedule(sorted, result.threads);
+            break;
+        }
+        case Strategy::Static:
+            result.makespan = ListSchedule(Blocks(result.threads, 1), result.threads);
+            break;
+
+        case Strategy::Dynamic:
+            result.makespan = ListSchedule(Blocks(result.threads, std::max(parameter, 1)), result.threads);
+            break;
+
+        case Strategy::Guided:
+            result.makespan = Guided(result.threads);
+            break;
+
+        case Strategy::WorkStealing:
+            result.makespan = WorkStealing(result.threads);
+            break;
+
+        case Strategy::FIFO:
+        default:
+            result.makespan = ListSchedule(m_durations, result.threads);
+            break;
+        }
+        double work = 0;
+        for (double duration : m_durations)
+            work += duration;
+        if (result.makespan > 0)
+            result.utilization = work / (result.makespan * result.threads);
+        return result;
+    }
+
+    /*! \brief Simulate all strategies for every thread count, dynamic dividers are taken from dividers */
+    std::vector<Result> Compare(const std::vector<int>& threads, const std::vector<int>& dividers = { 2, 3, 4 }) const
+    {
+        std::vector<Result> results;
+        for (int count : threads) {
+            results.push_back(Simulate(Strategy::FIFO, count));
+            results.push_back(Simulate(Strategy::LPT, count));
+            results.push_back(Simulate(Strategy::Static, count));
+            for (int divide : dividers)
+                results.push_back(Simulate(Strategy::Dynamic, count, divide));
+            results.push_back(Simulate(Strategy::Guided, count));
+            results.push_back(Simulate(Strategy::WorkStealing, count));
+        }
+        return results;
+    }
+
+    static std::string Name(const Result& result)
+    {
+        switch (result.strategy) {
+        case Strategy::LPT:
+            return "LPT";
+        case Strategy::Static:
+            return "Static";
+        case Strategy::Dynamic:
+            return "Dynamic(" + std::to_string(result.parameter) + ")";
+        case Strategy::Guided:
+            return "Guided";
+        case Strategy::WorkStealing:
+            return "WorkStealing";
+        case Strategy::FIFO:
+        default:
+            return "FIFO";
+        }
+    }
+
+    static void Print(const std::vector<Result>& results, std::ostream& stream = std::cout)
+    {
+        stream << std::left << std::setw(16) << "Strategy" << std::right
+               << std::setw(10) << "threads"
+               << std::setw(16) << "makespan [ms]"
+               << std::setw(14) << "utilisation" << std::endl;
+        for (const auto& result : results)
+            stream << std::left << std::setw(16) << Name(result) << std::right << std::fixed << std::setprecision(3)
+                   << std::setw(10) << result.threads
+                   << std::setw(16) << result.makespan
+                   << std::setw(13) << result.utilization * 100 << "%" << std::endl;
+        stream.unsetf(std::ios_base::floatfield);
+    }
+
+private:
+    /* Every unit goes to the thread that becomes idle first */
+    double ListSchedule(const std::vector<double>& units, int threads) const
+    {
+        std::priority_queue<double, std::vector<double>, std::greater<double>> idle;
+        for (int i = 0; i < threads; ++i)
+            idle.push(0);
+        double makespan = 0;
+        for (double unit : units) {
+            double end = idle.top() + unit + m_overhead;
+            idle.pop();
+            idle.push(end);
+            makespan = std::max(makespan, end);
+        }
+        return makespan;
+    }
+
+    /* Same block layout as CxxThreadPool::DynamicPool, StaticPool corresponds to divide = 1 */
+    std::vector<double> Blocks(int threads, int divide) const
+    {
+        if (m_durations.size() / 2 / threads == 0)
+            return m_durations;
+        std::vector<double> blocks;
+        std::size_t index = 0;
+        while (index < m_durations.size()) {
+            int remaining = m_durations.size() - index;
+            int thread_count = remaining / divide / threads;
+            if (thread_count) {
+                for (int j = 0; j < threads && index < m_durations.size(); ++j) {
+                    double block = 0;
+                    for (int i = 0; i < thread_count && index < m_durations.size(); ++i)
+                        block += m_durations[index++];
+                    blocks.push_back(block);
+                }
+            } else
+                blocks.push_back(m_durations[index++]);
+        }
+        return blocks;
+    }
+
+    double Guided(int threads) const
+    {
+        std::priority_queue<double, std::vector<double>, std::greater<double>> idle;
+        for (int i = 0; i < threads; ++i)
+            idle.push(0);
+        double makespan = 0;
+        std::size_t index = 0;
+        while (index < m_durations.size()) {
+            std::size_t chunk = std::max<std::size_t>((m_durations.size() - index) / threads, 1);
+            double end = idle.top() + m_overhead;
+            idle.pop();
+            for (std::size_t i = 0; i < chunk && index < m_durations.size(); ++i)
+                end += m_durations[index++];
+            idle.push(end);
+            makespan = std::max(makespan, end);
+        }
+        return makespan;
+    }
+
+    double WorkStealing(int threads) const
+    {
+        /* every thread owns the contiguous range [first, second) */
+        std::vector<std::pair<std::size_t, std::size_t>> ranges(threads);
+        std::size_t block = m_durations.size() / threads, rest = m_durations.size() % threads, begin = 0;
+        for (int i = 0; i < threads; ++i) {
+            std::size_t size = block + (std::size_t(i) < rest ? 1 : 0);
+            ranges[i] = std::make_pair(begin, begin + size);
+            begin += size;
+        }
+
+        typedef std::pair<double, int> Event;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+        for (int i = 0; i < threads; ++i)
+            events.push(Event(m_overhead, i));
+        double makespan = 0;
+        while (!events.empty()) {
+            Event event = events.top();
+            events.pop();
+            double time = event.first;
+            int thread = event.second;
+            makespan = std::max(makespan, time);
+            auto& own = ranges[thread];
+            if (own.first == own.second) {
+                int victim = -1;
+                std::size_t largest = 0;
+                for (int i = 0; i < threads; ++i) {
+                    std::size_t size = ranges[i].second - ranges[i].first;
+                    if (size > largest) {
+                        largest = size;
+                        victim = i;
+                    }
+                }
+                if (victim == -1)
+                    continue;
+                std::size_t steal = (largest + 1) / 2;
+                own = std::make_pair(ranges[victim].second - steal, ranges[victim].second);
+                ranges[victim].second -= steal;
+                time += m_overhead;
+            }
+            events.push(Event(time + m_durations[own.first++], thread));
+        }
+        return makespan;
+    }
+
+    std::vector<double> m_durations;
+    double m_overhead = 0;
+};
@@ -0,0 +1,206 @@
+/*
+ * <CPU and cache topology from sysfs for CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*! \brief Cache and NUMA layout of the online CPUs, read from sysfs
+ * The sysfs root can be changed to a fake directory tree for testing */
+class CxxTopology {
+public:
+    /*! \brief Topological distance between two CPUs, smaller is closer */
+    enum Level {
+        Same = 0,
+        SMT = 1, /* hyper thread siblings */
+        L2 = 2, /* shared L2 cache */
+        L3 = 3, /* shared L3 cache */
+        Node = 4, /* same NUMA node */
+        Remote = 5
+    };
+
+    static const int Levels = 6;
+
+    /*! \brief Core type on hybrid processors */
+    enum CoreType {
+        Unknown = 0,
+        Performance = 1, /* P-core, cpu_core */
+        Efficiency = 2 /* E-core, cpu_atom */
+    };
+
+    CxxTopology() = default;
+
+    /*! \brief Read the topology below root ( usually /sys ), returns false if no online CPU was found */
+    bool Load(const std::string& root = "/sys")
+    {
+        m_cpus.clear();
+        m_info.clear();
+        std::string cpu_root = root + "/devices/system/cpu/";
+        m_cpus = ParseList(ReadLine(cpu_root + "online"));
+        if (m_cpus.empty())
+            return false;
+
+        m_info.assign(*std::max_element(m_cpus.begin(), m_cpus.end()) + 1, Info());
+        for (int cpu : m_cpus) {
+            std::string path = cpu_root + "cpu" + std::to_string(cpu) + "/";
+            Info& info = m_info[cpu];
+            info.smt = First(ReadLine(path + "topology/thread_siblings_list"));
+            info.package = Number(ReadLine(path + "topology/physical_package_id"));
+            for (int index = 0; index < 16; ++index) {
+                std::string cache = path + "cache/index" + std::to_string(index) + "/";
+                std::string level = ReadLine(cache + "level");
+                if (level.empty() || ReadLine(cache + "type") == "Instruction")
+                    continue;
+                if (level == "2")
+                    info.l2 = First(ReadLine(cache + "shared_cpu_list"));
+                else if (level == "3")
+                    info.l3 = First(ReadLine(cache + "shared_cpu_list"));
+            }
+        }
+        for (int cpu : ParseList(ReadLine(root + "/devices/cpu_core/cpus")))
+            if (cpu < m_info.size())
+                m_info[cpu].type = Performance;
+        for (int cpu : ParseList(ReadLine(root + "/devices/cpu_atom/cpus")))
+            if (cpu < m_info.size())
+                m_info[cpu].type = Efficiency;
+        double max = 0;
+        for (int cpu : m_cpus) {
+            std::string capacity = ReadLine(cpu_root + "cpu" + std::to_string(cpu) + "/cpu_capacity");
+            m_info[cpu].capacity = capacity.empty() ? -1 : std::atof(capacity.c_str());
+            max = std::max(max, m_info[cpu].capacity);
+        }
+        /* cpu_capacity is scaled to 1024 for the fastest core, fall back to the core type if it is missing */
+        for (int cpu : m_cpus) {
+            Info& info = m_info[cpu];
+            if (info.capacity > 0 && max > 0)
+                info.capacity /= max;
+            else
+                info.capacity = info.type == Efficiency ? m_efficiency_capacity : 1.0;
+        }
+
+        std::string node_root = root + "/devices/system/node/";
+        for (int node : ParseList(ReadLine(node_root + "online")))
+            for (int cpu : ParseList(ReadLine(node_root + "node" + std::to_string(node) + "/cpulist")))
+                if (cpu < m_info.size())
+                    m_info[cpu].node = node;
+        return true;
+    }
+
+    inline const std::vector<int>& Cpus() const { return m_cpus; }
+
+    inline CoreType Type(int cpu) const { return cpu >= 0 && cpu < m_info.size() ? m_info[cpu].type : Unknown; }
+
+    /*! \brief Compute capacity relative to the fastest core, between 0 and 1 */
+    inline double Capacity(int cpu) const { return cpu >= 0 && cpu < m_info.size() ? m_info[cpu].capacity : 1.0; }
+
+    /*! \brief True if the cores differ in capacity */
+    bool Hybrid() const
+    {
+        for (int cpu : m_cpus)
+            if (Capacity(cpu) < 0.99)
+                return true;
+        return false;
+    }
+
+    /*! \brief Relative capacity assumed for E-cores if the kernel provides no cpu_capacity, set before Load() */
+    inline void setEfficiencyCapacity(double capacity) { m_efficiency_capacity = capacity; }
+
+    Level Distance(int a, int b) const
+    {
+        if (a == b)
+            return Same;
+        if (a < 0 || b < 0 || a >= m_info.size() || b >= m_info.size())
+            return Remote;
+        const Info& x = m_info[a];
+        const Info& y = m_info[b];
+        if (x.smt >= 0 && x.smt == y.smt)
+            return SMT;
+        if (x.l2 >= 0 && x.l2 == y.l2)
+            return L2;
+        if (x.l3 >= 0 && x.l3 == y.l3)
+            return L3;
+        if (x.node >= 0 && y.node >= 0)
+            return x.node == y.node ? Node : Remote;
+        return x.package == y.package ? Node : Remote;
+    }
+
+    static const char* Name(int distance)
+    {
+        static const char* names[Levels] = { "same", "smt", "l2", "l3", "node", "remote" };
+        return distance >= 0 && distance < Levels ? names[distance] : "?";
+    }
+
+    /*! \brief Parse a sysfs cpu list like 0-3,8,10-11 */
+    static std::vector<int> ParseList(const std::string& list)
+    {
+        std::vector<int> result;
+        std::stringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty())
+                continue;
+            std::size_t dash = range.find('-');
+            int first = std::atoi(range.substr(0, dash).c_str());
+            int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+            for (int cpu = first; cpu <= last; ++cpu)
+                result.push_back(cpu);
+        }
+        return result;
+    }
+
+    static std::string ReadLine(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        std::string line;
+        std::getline(file, line);
+        while (line.size() && (line.back() == '\n' || line.back() == ' '))
+            line.pop_back();
+        return line;
+    }
+
+private:
+    struct Info {
+        int smt = -1, l2 = -1, l3 = -1, node = -1, package = -1;
+        CoreType type = Unknown;
+        double capacity = 1.0;
+    };
+
+    /* caches and siblings are identified by the first CPU of their shared list */
+    static int First(const std::string& list)
+    {
+        std::vector<int> cpus = ParseList(list);
+        return cpus.empty() ? -1 : *std::min_element(cpus.begin(), cpus.end());
+    }
+
+    static int Number(const std::string& line) { return line.empty() ? -1 : std::atoi(line.c_str()); }
+
+    std::vector<int> m_cpus;
+    std::vector<Info> m_info;
+    double m_efficiency_capacity = 0.6;
+};
@@ -0,0 +1,191 @@
+/*
+ * <Thread names and trace markers for profiling CxxThreadPool.>
+ * Copyright (C) 2024 Conrad Hübler <Conrad.Huebler@gmx.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(_CxxThreadPool_Trace) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define _CxxThreadPool_Usdt
+#endif
+#endif
+
+/*! \brief Thread names and job markers for perf, trace-cmd and Perfetto timelines
+ * The job hooks in CxxThread::start() are only compiled if _CxxThreadPool_Trace is defined. They then fire the USDT probes
+ * cxxthreadpool:job_begin ( id, job, type ) and cxxthreadpool:job_end ( id, job, return value ) if <sys/sdt.h> is
+ * available, and write begin and end markers to the ftrace trace_marker file once enabled at runtime or with the
+ * environment variable CxxThreadTrace=1 */
+class CxxTrace {
+public:
+    static CxxTrace& Instance()
+    {
+        static CxxTrace trace;
+        return trace;
+    }
+
+    ~CxxTrace()
+    {
+#if defined(__linux__)
+        if (m_file >= 0)
+            close(m_file);
+#endif
+    }
+
+    CxxTrace(const CxxTrace&) = delete;
+    CxxTrace& operator=(const CxxTrace&) = delete;
+
+    /*! \brief Name the calling thread, the kernel keeps the first 15 characters */
+    static void setThreadName(const char* name)
+    {
+#if defined(__linux__)
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%s", name);
+        pthread_setname_np(pthread_self(), buffer);
+#else
+        (void)name;
+#endif
+    }
+
+    /*! \brief Readable name of a type from its mangled name ( std::type_info::name() ), demangled with GCC and Clang */
+    static std::string TypeName(const char* mangled)
+    {
+#if defined(__GNUG__)
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+        if (status == 0 && demangled) {
+            std::string name(demangled);
+            std::free(demangled);
+            return name;
+        }
+#endif
+        return mangled;
+    }
+
+    /*! \brief Write job markers to trace_marker ( or another file, for testing ), returns false if it can not be opened
+     * The file is opened once and kept open, enabling again only switches the markers on */
+    bool Enable(const std::string& filename = std::string())
+    {
+#if defined(__linux__)
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_file < 0) {
+            const char* candidates[] = { "/sys/kernel/tracing/trace_marker", "/sys/kernel/debug/tracing/trace_marker" };
+            if (filename.size())
+                m_file = open(filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+            for (int i = 0; i < 2 && m_file < 0 && filename.empty(); ++i)
+                m_file = open(candidates[i], O_WRONLY | O_CLOEXEC);
+        }
+        m_enabled.store(m_file >= 0, std::memory_order_release);
+        return m_file >= 0;
+#else
+        (void)filename;
+        return false;
+#endif
+    }
+
+    inline void Disable() { m_enabled.store(false, std::memory_order_relaxed); }
+    inline bool Enabled() const { return m_enabled.load(std::memory_order_acquire); }
+
+    /* Markers use the atrace format ( B|pid|name and E|pid ), which Perfetto shows as slices of the writing thread */
+    inline void Begin(const void* job, int id, const std::type_info& type)
+    {
+#ifdef _CxxThreadPool_Usdt
+        DTRACE_PROBE3(cxxthreadpool, job_begin, id, job, type.name());
+#else
+        (void)job;
+#endif
+        if (!Enabled())
+            return;
+        char buffer[256];
+        int length = std::snprintf(buffer, sizeof(buffer), "B|%d|job %d %s\n", Process(), id, TypeName(type.name()).c_str());
+        Write(buffer, std::min(length, int(sizeof(buffer)) - 1));
+    }
+
+    inline void End(const void* job, int id, int result)
+    {
+#ifdef _CxxThreadPool_Usdt
+        DTRACE_PROBE3(cxxthreadpool, job_end, id, job, result);
+#else
+        (void)job;
+        (void)id;
+        (void)result;
+#endif
+        if (!Enabled())
+            return;
+        char buffer[32];
+        Write(buffer, std::snprintf(buffer, sizeof(buffer), "E|%d\n", Process()));
+    }
+
+private:
+    CxxTrace()
+    {
+        if (const char* trace = std::getenv("CxxThreadTrace"))
+            if (std::atoi(trace) > 0)
+                Enable();
+    }
+
+    static int Process()
+    {
+#if defined(__linux__)
+        return getpid();
+#else
+        return 0;
+#endif
+    }
+
+    /* a single write per marker, so that the markers of concurrent threads do not interleave */
+    void Write(const char* buffer, int length)
+    {
+#if defined(__linux__)
+        if (length > 0 && write(m_file, buffer, length) < 0)
+            return;
+#else
+        (void)buffer;
+        (void)length;
+#endif
+    }
+
+    std::mutex m_mutex;
+    std::atomic<bool> m_enabled { false };
+    int m_file = -1;
+};
@@ -26,6 +26,7 @@
 #define _CxxThreadPool_BarWidth 100
 
 #include "include/CxxThreadPool.h"
+#include "include/Simulator.h"
 #include "include/Timer.h"
 
 #include <iostream>
@@ -62,7 +63,7 @@ int main()
     pool->setActiveThreadCount(active_threads);
     pool->setProgressBar(CxxThreadPool::ProgressBarType::Discrete);
 
-    //pool->EcoBar(true);
+    //pool->setEcoMode(true, 100);
     std::cout << "This a example application to present the CxxThreadPool method!\nThe demo will run with " << max_threads << " jobs and " << active_threads << " active threads!\n";
     std::cout << "Each thread will be initialised with a random number : rand_r(&seed)/1e6 - that equals the msecs to sleep.\n";
     std::cout << "The thread pool will run a couple of times - with the same threads and random numbers to demonstrate the :\nSingle Pool,\nStatic Pool and\nDynamic Pool ability of the CxxThreadPool Class.\n\n";
@@ -74,6 +75,11 @@ int main()
     std::cout << "Single Pool: Each thread will be run isolated, so " << max_threads << " will be executed." << std::endl;
     pool->StartAndWait();
 
+    std::cout << "Replaying the recorded job durations of the single pool for the other strategies:" << std::endl;
+    CxxScheduleSimulator simulator;
+    simulator.setDurations(pool->Durations());
+    CxxScheduleSimulator::Print(simulator.Compare({ active_threads }));
+
     pool->Reset();
 
     std::cout << "Static Pool: " << max_threads / active_threads << " threads will be executed ( + remaining individual threads )." << std::endl;